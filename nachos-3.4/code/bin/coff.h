@@ -47,3 +47,58 @@ struct scnhdr {
         long            s_flags;        /* flags */
       };
  
+
+/*
+ * The symbol table.  f_symptr points to the symbolic header; we only
+ * use the external symbols and their string space, which is all that
+ * a linked executable needs to name its procedures.
+ */
+
+typedef struct {
+        short   magic;          /* MAGIC_SYM */
+        short   vstamp;         /* version stamp */
+        long    ilineMax;       /* number of line number entries */
+        long    cbLine;         /* number of bytes for line numbers */
+        long    cbLineOffset;   /* offset to line numbers */
+        long    idnMax;         /* max index into dense numbers */
+        long    cbDnOffset;     /* offset to dense numbers */
+        long    ipdMax;         /* number of procedures */
+        long    cbPdOffset;     /* offset to procedure descriptors */
+        long    isymMax;        /* number of local symbols */
+        long    cbSymOffset;    /* offset to local symbols */
+        long    ioptMax;        /* max index into optimization entries */
+        long    cbOptOffset;    /* offset to optimization entries */
+        long    iauxMax;        /* number of auxiliary symbols */
+        long    cbAuxOffset;    /* offset to auxiliary symbols */
+        long    issMax;         /* max index into local strings */
+        long    cbSsOffset;     /* offset to local strings */
+        long    issExtMax;      /* max index into external strings */
+        long    cbSsExtOffset;  /* offset to external strings */
+        long    ifdMax;         /* number of file descriptors */
+        long    cbFdOffset;     /* offset to file descriptors */
+        long    crfd;           /* number of relative file descriptors */
+        long    cbRfdOffset;    /* offset to relative file descriptors */
+        long    iextMax;        /* number of external symbols */
+        long    cbExtOffset;    /* offset to external symbols */
+      } HDRR;
+
+#define MAGIC_SYM       0x7009
+
+typedef struct {
+        long            iss;            /* index into string space */
+        long            value;          /* address, for procedures */
+        unsigned        st : 6;         /* symbol type */
+        unsigned        sc : 5;         /* storage class */
+        unsigned        reserved : 1;
+        unsigned        index : 20;     /* index into aux symbols */
+      } SYMR;
+
+typedef struct {
+        unsigned short  flags;          /* jmptbl, cobol_main, weakext */
+        short           ifd;            /* file the symbol is defined in */
+        SYMR            asym;
+      } EXTR;
+
+#define stProc          6               /* st: a procedure */
+#define stStaticProc    14              /* st: a static procedure */
+#define scText          1               /* sc: in the text section */
@@ -32,7 +32,8 @@
 // 	Initialize a fresh file header for a newly created file.
 //	Allocate data blocks for the file out of the map of free disk blocks.
 //	Return FALSE if there are not enough free blocks to accomodate
-//	the new file.
+//	the new file.  The version starts at 0; FileSystem::Create gives
+//	the file a new one.
 //
 //	"freeMap" is the bit map of free disk sectors
 //	"fileSize" is the bit map of free disk sectors
@@ -41,6 +42,7 @@
 bool
 FileHeader::Allocate(BitMap *freeMap, int fileSize)
 { 
+    version = 0;
     numBytes = fileSize;
     numSectors  = divRoundUp(fileSize, SectorSize);
     if (freeMap->NumClear() < numSectors)
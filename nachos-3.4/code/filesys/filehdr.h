@@ -17,7 +17,7 @@
 #include "disk.h"
 #include "bitmap.h"
 
-#define NumDirect 	((SectorSize - 2 * sizeof(int)) / sizeof(int))
+#define NumDirect 	((SectorSize - 3 * sizeof(int)) / sizeof(int))
 #define MaxFileSize 	(NumDirect * SectorSize)
 
 // The following class defines the Nachos "file header" (in UNIX terms,  
@@ -56,7 +56,12 @@ class FileHeader {
 
     void Print();			// Print the contents of the file.
 
+    int Version() { return version; }	// Changes whenever the file is
+    void SetVersion(int v) { version = v; }	// created, written or
+					// removed (see openfile.h)
+
   private:
+    int version;			// (see Version)
     int numBytes;			// Number of bytes in the file
     int numSectors;			// Number of data sectors in the file
     int dataSectors[NumDirect];		// Disk sector numbers for each data 
@@ -156,6 +156,10 @@ FileSystem::FileSystem(bool format)
 //	  Store the new file header on disk 
 //	  Flush the changes to the bitmap and the directory back to disk
 //
+//	The new file's version is one more than that of the last file whose
+//	header was in the same sector, so that nobody takes it for that one
+//	(see OpenFile::Version).
+//
 //	Return TRUE if everything goes ok, otherwise, return FALSE.
 //
 // 	Create fails if:
@@ -177,7 +181,7 @@ FileSystem::Create(const char *name, int initialSize)
     Directory *directory;
     BitMap *freeMap;
     FileHeader *hdr;
-    int sector;
+    int sector, version;
     bool success;
 
     DEBUG('f', "Creating file %s, size %d\n", name, initialSize);
@@ -197,10 +201,13 @@ FileSystem::Create(const char *name, int initialSize)
             success = FALSE;	// no space in directory
 	else {
     	    hdr = new FileHeader;
+	    hdr->FetchFrom(sector);	// whatever header was there last
+	    version = hdr->Version();
 	    if (!hdr->Allocate(freeMap, initialSize))
             	success = FALSE;	// no space on disk for data
 	    else {	
 	    	success = TRUE;
+		hdr->SetVersion(version + 1);
 		// everthing worked, flush all changes back to disk
     	    	hdr->WriteBack(sector); 		
     	    	directory->WriteBack(directoryFile);
@@ -248,6 +255,9 @@ FileSystem::Open(const char *name)
 //	    Delete the space for its data blocks
 //	    Write changes to directory, bitmap back to disk
 //
+//	The header is left where it was, with a new version, so that a
+//	file created in its place later gets a newer one still.
+//
 //	Return TRUE if the file was deleted, FALSE if the file wasn't
 //	in the file system.
 //
@@ -275,6 +285,8 @@ FileSystem::Remove(const char *name)
     freeMap = new BitMap(NumSectors);
     freeMap->FetchFrom(freeMapFile);
 
+    fileHdr->SetVersion(fileHdr->Version() + 1);
+    fileHdr->WriteBack(sector);
     fileHdr->Deallocate(freeMap);  		// remove data blocks
     freeMap->Clear(sector);			// remove header block
     directory->Remove(name);
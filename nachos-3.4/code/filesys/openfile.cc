@@ -31,7 +31,9 @@ OpenFile::OpenFile(int sector)
 { 
     hdr = new FileHeader;
     hdr->FetchFrom(sector);
+    headerSector = sector;
     seekPosition = 0;
+    written = FALSE;
 }
 
 //----------------------------------------------------------------------
@@ -41,9 +43,45 @@ OpenFile::OpenFile(int sector)
 
 OpenFile::~OpenFile()
 {
+    if (written)
+	NewVersion();
     delete hdr;
 }
 
+//----------------------------------------------------------------------
+// OpenFile::Version
+// 	Return the version of the file: a number that changes whenever
+//	the file is written.  Anyone who kept something read from the file
+//	(like a program image) can tell from it whether that is still
+//	up to date.
+//
+//	Rather than update the header on disk at every write, we give the
+//	file a new version at the first write through each OpenFile, and
+//	again when it is closed.  Whatever was read in between has the
+//	first of these, so it is out of date once the file is closed.
+//----------------------------------------------------------------------
+
+int
+OpenFile::Version()
+{
+    return hdr->Version();
+}
+
+//----------------------------------------------------------------------
+// OpenFile::NewVersion
+// 	Bump the file's version on disk.  We read the header back in first,
+//	in case the file has been given a new version through some other
+//	OpenFile since we opened it.
+//----------------------------------------------------------------------
+
+void
+OpenFile::NewVersion()
+{
+    hdr->FetchFrom(headerSector);
+    hdr->SetVersion(hdr->Version() + 1);
+    hdr->WriteBack(headerSector);
+}
+
 //----------------------------------------------------------------------
 // OpenFile::Seek
 // 	Change the current location within the open file -- the point at
@@ -157,6 +195,10 @@ OpenFile::WriteAt(const char *from, int numBytes, int position)
 	numBytes = fileLength - position;
     DEBUG('f', "Writing %d bytes at %d, from file of length %d.\n", 	
 			numBytes, position, fileLength);
+    if (!written) {			// (see Version)
+	NewVersion();
+	written = TRUE;
+    }
 
     firstSector = divRoundDown(position, SectorSize);
     lastSector = divRoundDown(position + numBytes - 1, SectorSize);
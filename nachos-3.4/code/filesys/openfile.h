@@ -52,6 +52,10 @@ class OpenFile {
 		}
 
     int Length() { Lseek(file, 0, 2); return Tell(file); }
+    int HeaderSector() { return FileId(file); }
+					// (on the host, the file's inode
+					// number identifies it instead)
+    int Version() { return FileVersion(file); }
     
   private:
     int file;
@@ -85,10 +89,20 @@ class OpenFile {
 					// file (this interface is simpler 
 					// than the UNIX idiom -- lseek to 
 					// end of file, tell, lseek back 
+    int HeaderSector() { return headerSector; }
+					// Where the header is; identifies
+					// the file
+    int Version();			// Changes when the file is written
+					// (or another file is created in
+					// its place)
     
   private:
     FileHeader *hdr;			// Header for this file 
+    int headerSector;			// ... and where it is on disk
     int seekPosition;			// Current position within the file
+    bool written;			// Written through us since we opened
+					// it?
+    void NewVersion();			// Give the file a new version
 };
 
 #endif // FILESYS
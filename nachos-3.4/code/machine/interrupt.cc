@@ -23,6 +23,9 @@
 #include "copyright.h"
 #include "interrupt.h"
 #include "system.h"
+#ifdef USER_PROGRAM
+#include "profile.h"
+#endif
 
 // String definitions for debugging messages
 
@@ -31,23 +34,258 @@ static const char *intTypeNames[] = { "timer", "disk", "console write",
 			"console read", "network send", "network recv"};
 
 //----------------------------------------------------------------------
-// PendingInterrupt::PendingInterrupt
-// 	Initialize a hardware device interrupt that is to be scheduled 
-//	to occur in the near future.
+// PendingQueue::PendingQueue
+// 	Initialize an empty queue of pending interrupts, with room for a
+//	few to start with.
+//----------------------------------------------------------------------
+
+PendingQueue::PendingQueue()
+{
+    capacity = 0;
+    numPending = numFree = 0;
+    nextSeq = 0;
+    pool = NULL;
+    heap = freeSlots = NULL;
+    Grow();
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::~PendingQueue
+// 	De-allocate the queue.
+//----------------------------------------------------------------------
+
+PendingQueue::~PendingQueue()
+{
+    delete [] pool;
+    delete [] heap;
+    delete [] freeSlots;
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::Grow
+// 	Double the number of slots.  Pending interrupts keep their slot
+//	numbers (and so their ids); only the arrays move.
+//----------------------------------------------------------------------
+
+void
+PendingQueue::Grow()
+{
+    int newCapacity = (capacity == 0) ? 16 : capacity * 2;
+    PendingInterrupt *newPool = new PendingInterrupt[newCapacity];
+    int *newHeap = new int[newCapacity];
+    int *newFree = new int[newCapacity];
+    int i;
+
+    ASSERT(newCapacity <= MaxPendingSlots);
+    for (i = 0; i < capacity; i++)
+	newPool[i] = pool[i];
+    for (i = 0; i < numPending; i++)
+	newHeap[i] = heap[i];
+    for (i = 0; i < numFree; i++)
+	newFree[i] = freeSlots[i];
+    for (i = newCapacity - 1; i >= capacity; i--) {	// the new slots
+	newPool[i].heapPos = -1;
+	newPool[i].generation = 0;
+	newFree[numFree++] = i;
+    }
+    delete [] pool;
+    delete [] heap;
+    delete [] freeSlots;
+    pool = newPool;
+    heap = newHeap;
+    freeSlots = newFree;
+    capacity = newCapacity;
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::Earlier
+// 	Return TRUE if the interrupt in slot "a" is to fire before the
+//	one in slot "b": it is due sooner, or due at the same time and
+//	was scheduled first.
+//----------------------------------------------------------------------
+
+bool
+PendingQueue::Earlier(int a, int b)
+{
+    if (pool[a].when != pool[b].when)
+	return (pool[a].when < pool[b].when);
+    return ((int) (pool[a].seq - pool[b].seq) < 0);	// (ok if seq wraps)
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::Place, SiftUp, SiftDown
+// 	The usual binary heap operations.  heap[0] fires first; the
+//	children of heap[i] are heap[2i+1] and heap[2i+2].
+//----------------------------------------------------------------------
+
+void
+PendingQueue::Place(int pos, int slot)
+{
+    heap[pos] = slot;
+    pool[slot].heapPos = pos;
+}
+
+void
+PendingQueue::SiftUp(int pos)
+{
+    int slot = heap[pos];
+    int parent;
+
+    while (pos > 0) {
+	parent = (pos - 1) / 2;
+	if (!Earlier(slot, heap[parent]))
+	    break;
+	Place(pos, heap[parent]);
+	pos = parent;
+    }
+    Place(pos, slot);
+}
+
+void
+PendingQueue::SiftDown(int pos)
+{
+    int slot = heap[pos];
+    int child;
+
+    for (;;) {
+	child = 2 * pos + 1;
+	if (child >= numPending)
+	    break;
+	if ((child + 1 < numPending) && Earlier(heap[child + 1], heap[child]))
+	    child++;
+	if (!Earlier(heap[child], slot))
+	    break;
+	Place(pos, heap[child]);
+	pos = child;
+    }
+    Place(pos, slot);
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::Insert
+// 	Add an interrupt to the queue, in a free slot.
 //
-//	"func" is the procedure to call when the interrupt occurs
-//	"param" is the argument to pass to the procedure
-//	"time" is when (in simulated time) the interrupt is to occur
-//	"kind" is the hardware device that generated the interrupt
+// Returns:
+//	an id for the interrupt, to pass to Cancel
 //----------------------------------------------------------------------
 
-PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, int param, int time, 
-				IntType kind)
+int
+PendingQueue::Insert(VoidFunctionPtr handler, int arg, int when, IntType type)
 {
-    handler = func;
-    arg = param;
-    when = time;
-    type = kind;
+    int slot;
+    PendingInterrupt *pend;
+
+    if (numFree == 0)
+	Grow();
+    slot = freeSlots[--numFree];
+    pend = &pool[slot];
+    pend->handler = handler;
+    pend->arg = arg;
+    pend->when = when;
+    pend->type = type;
+    pend->seq = nextSeq++;
+    Place(numPending++, slot);
+    SiftUp(pend->heapPos);
+    return (pend->generation * MaxPendingSlots) + slot;
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::Front
+// 	Return the interrupt that is to fire first, without removing it,
+//	or NULL if nothing is pending.
+//----------------------------------------------------------------------
+
+PendingInterrupt *
+PendingQueue::Front()
+{
+    if (numPending == 0)
+	return NULL;
+    return &pool[heap[0]];
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::RemoveAt
+// 	Take the interrupt at heap[pos] out of the heap, and free its slot.
+//----------------------------------------------------------------------
+
+void
+PendingQueue::RemoveAt(int pos)
+{
+    int slot = heap[pos];
+    int last = heap[--numPending];
+
+    pool[slot].heapPos = -1;
+    pool[slot].generation = (pool[slot].generation + 1) & 0x7fff;
+    freeSlots[numFree++] = slot;
+    if (pos == numPending)		// it was the last one
+	return;
+    Place(pos, last);			// otherwise fill the hole
+    if ((pos > 0) && Earlier(last, heap[(pos - 1) / 2]))
+	SiftUp(pos);
+    else
+	SiftDown(pos);
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::RemoveFront
+// 	Remove the interrupt that is to fire first.  We copy it out,
+//	since its slot may be reused as soon as the handler schedules
+//	another interrupt.
+//
+//	"copy" -- where to put the interrupt
+//----------------------------------------------------------------------
+
+void
+PendingQueue::RemoveFront(PendingInterrupt *copy)
+{
+    ASSERT(numPending > 0);
+    *copy = pool[heap[0]];
+    RemoveAt(0);
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::Cancel
+// 	Remove a pending interrupt, so that it never fires.
+//
+// Returns:
+//	FALSE if "id" no longer names a pending interrupt (it has
+//	already fired, or been cancelled).
+//----------------------------------------------------------------------
+
+bool
+PendingQueue::Cancel(int id)
+{
+    int slot = id % MaxPendingSlots;
+
+    if ((id < 0) || (slot >= capacity) || (pool[slot].heapPos == -1)
+	    || (pool[slot].generation != id / MaxPendingSlots))
+	return FALSE;
+    RemoveAt(pool[slot].heapPos);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::Print
+// 	Call "func" on each pending interrupt, in the order in which
+//	they will fire.  Only used for debugging, so we just sort a copy
+//	of the heap.
+//----------------------------------------------------------------------
+
+void
+PendingQueue::Print(VoidFunctionPtr func)
+{
+    int *order = new int[numPending];
+    int i, j, slot;
+
+    for (i = 0; i < numPending; i++) {	// insertion sort
+	slot = heap[i];
+	for (j = i; (j > 0) && Earlier(slot, order[j - 1]); j--)
+	    order[j] = order[j - 1];
+	order[j] = slot;
+    }
+    for (i = 0; i < numPending; i++)
+	(*func)((int) &pool[order[i]]);
+    delete [] order;
 }
 
 //----------------------------------------------------------------------
@@ -60,10 +298,13 @@ PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, int param, int time,
 Interrupt::Interrupt()
 {
     level = IntOff;
-    pending = new List();
+    pending = new PendingQueue();
     inHandler = FALSE;
     yieldOnReturn = FALSE;
+    switchOnReturn = FALSE;
     status = SystemMode;
+    nextDue = NeverDue;
+    tracing = DebugIsEnabled('i');
 }
 
 //----------------------------------------------------------------------
@@ -73,8 +314,6 @@ Interrupt::Interrupt()
 
 Interrupt::~Interrupt()
 {
-    while (!pending->IsEmpty())
-	delete (PendingInterrupt*)(pending->Remove());
     delete pending;
 }
 
@@ -146,6 +385,9 @@ Interrupt::Enable()
 //	Two things can cause OneTick to be called:
 //		interrupts are re-enabled
 //		a user instruction is executed
+//
+//	Most ticks come before the next interrupt is due (nextDue);
+//	then all we have to do is advance the time.
 //----------------------------------------------------------------------
 void
 Interrupt::OneTick()
@@ -160,8 +402,76 @@ Interrupt::OneTick()
 	stats->totalTicks += UserTick;
 	stats->userTicks += UserTick;
     }
+    if ((stats->totalTicks < nextDue) && !tracing)
+	return;					// nothing can be due yet
     DEBUG('i', "\n== Tick %d ==\n", stats->totalTicks);
+    FireDueInterrupts(old);
+}
 
+//----------------------------------------------------------------------
+// Interrupt::UserTicks
+// 	Advance simulated time by "count" user instructions in one step,
+//	and then check for pending interrupts, just as "count" calls to
+//	OneTick would have.  Used by the simulator to charge a whole block
+//	of user instructions at once.
+//
+//	The caller must ensure no interrupt comes due before the last of
+//	the "count" instructions (cf. UserTicksUntilDue), otherwise the 
+//	interrupt would fire late.
+//----------------------------------------------------------------------
+void
+Interrupt::UserTicks(int count)
+{
+    ASSERT(status == UserMode);
+    stats->totalTicks += count * UserTick;
+    stats->userTicks += count * UserTick;
+    if ((stats->totalTicks < nextDue) && !tracing)
+	return;					// nothing can be due yet
+    DEBUG('i', "\n== Tick %d ==\n", stats->totalTicks);
+    FireDueInterrupts(UserMode);
+}
+
+//----------------------------------------------------------------------
+// Interrupt::UserTicksUntilDue
+// 	Return how many user instructions can execute before the first
+//	pending interrupt is due; after that many, the simulator must
+//	call OneTick or UserTicks so the interrupt fires on time.
+//	Returns NoInterruptDue if nothing is pending.
+//----------------------------------------------------------------------
+int
+Interrupt::UserTicksUntilDue()
+{
+    if (nextDue == NeverDue)
+	return NoInterruptDue;
+    if (nextDue <= stats->totalTicks)
+	return 1;
+    return divRoundUp(nextDue - stats->totalTicks, UserTick);
+}
+
+//----------------------------------------------------------------------
+// Interrupt::UpdateNextDue
+// 	Recompute when the first pending interrupt is due, after the
+//	front of the pending list has changed.
+//----------------------------------------------------------------------
+void
+Interrupt::UpdateNextDue()
+{
+    PendingInterrupt *first = pending->Front();
+
+    nextDue = (first == NULL) ? NeverDue : first->when;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::FireDueInterrupts
+// 	Invoke the handlers of all the interrupts that are now due, with
+//	interrupts disabled, and then do the context switch if one of
+//	the handlers asked for it.
+//
+//	"old" -- the machine status to go back to after the context switch
+//----------------------------------------------------------------------
+void
+Interrupt::FireDueInterrupts(MachineStatus old)
+{
 // check any pending interrupts are now ready to fire
     ChangeLevel(IntOn, IntOff);		// first, turn off interrupts
 					// (interrupt handlers run with
@@ -173,7 +483,25 @@ Interrupt::OneTick()
 					// for a context switch, ok to do it now
 	yieldOnReturn = FALSE;
  	status = SystemMode;		// yield is a kernel routine
+#ifdef USER_PROGRAM
+	currentThread->atUserBoundary = (old == UserMode);
 	currentThread->Yield();
+	currentThread->atUserBoundary = FALSE;
+#else
+	currentThread->Yield();
+#endif
+	status = old;
+    }
+    if (switchOnReturn) {		// likewise, if the current CPU's
+	switchOnReturn = FALSE;		// turn is over
+	status = SystemMode;
+#ifdef USER_PROGRAM
+	currentThread->atUserBoundary = (old == UserMode);
+	scheduler->SwitchCPU();
+	currentThread->atUserBoundary = FALSE;
+#else
+	scheduler->SwitchCPU();
+#endif
 	status = old;
     }
 }
@@ -196,6 +524,20 @@ Interrupt::YieldOnReturn()
     yieldOnReturn = TRUE; 
 }
 
+//----------------------------------------------------------------------
+// Interrupt::SwitchCPUOnReturn
+// 	Called from within an interrupt handler, to give the next CPU
+//	its turn, when the handler returns -- for the same reason as
+//	YieldOnReturn.
+//----------------------------------------------------------------------
+
+void
+Interrupt::SwitchCPUOnReturn()
+{ 
+    ASSERT(inHandler == TRUE);  
+    switchOnReturn = TRUE; 
+}
+
 //----------------------------------------------------------------------
 // Interrupt::Idle
 // 	Routine called when there is nothing in the ready queue.
@@ -217,6 +559,7 @@ Interrupt::Idle()
 	    ;				// interrupts
         yieldOnReturn = FALSE;		// since there's nothing in the
 					// ready queue, the yield is automatic
+	switchOnReturn = FALSE;
         status = SystemMode;
 	return;				// return in case there's now
 					// a runnable thread
@@ -235,12 +578,17 @@ Interrupt::Idle()
 
 //----------------------------------------------------------------------
 // Interrupt::Halt
-// 	Shut down Nachos cleanly, printing out performance statistics.
+// 	Shut down Nachos cleanly, printing out performance statistics
+//	(and the user program profiles, if there are any).
 //----------------------------------------------------------------------
 void
 Interrupt::Halt()
 {
     printf("Machine halting!\n\n");
+#ifdef USER_PROGRAM
+    PrintProfiles();
+#endif
+    scheduler->Account();
     stats->Print();
     Cleanup();     // Never returns.
 }
@@ -250,7 +598,8 @@ Interrupt::Halt()
 // 	Arrange for the CPU to be interrupted when simulated time
 //	reaches "now + when".
 //
-//	Implementation: just put it on a sorted list.
+//	Implementation: just put it on the pending queue.  Interrupts
+//	due at the same time fire in the order they were scheduled.
 //
 //	NOTE: the Nachos kernel should not call this routine directly.
 //	Instead, it is only called by the hardware device simulators.
@@ -260,18 +609,43 @@ Interrupt::Halt()
 //	"fromNow" is how far in the future (in simulated time) the 
 //		 interrupt is to occur
 //	"type" is the hardware device that generated the interrupt
+//
+// Returns:
+//	an id for the interrupt, which can be passed to Cancel
 //----------------------------------------------------------------------
-void
+int
 Interrupt::Schedule(VoidFunctionPtr handler, int arg, int fromNow, IntType type)
 {
     int when = stats->totalTicks + fromNow;
-    PendingInterrupt *toOccur = new PendingInterrupt(handler, arg, when, type);
 
     DEBUG('i', "Scheduling interrupt handler the %s at time = %d\n", 
 					intTypeNames[type], when);
     ASSERT(fromNow > 0);
 
-    pending->SortedInsert(toOccur, when);
+    if (when < nextDue)
+	nextDue = when;
+    return pending->Insert(handler, arg, when, type);
+}
+
+//----------------------------------------------------------------------
+// Interrupt::Cancel
+// 	Unschedule an interrupt, so that its handler is never called.
+//
+// Returns:
+//	FALSE if the interrupt has already fired (or been cancelled)
+//
+//	"id" is what Schedule returned for the interrupt
+//----------------------------------------------------------------------
+bool
+Interrupt::Cancel(int id)
+{
+    bool found = pending->Cancel(id);
+
+    if (found)
+	UpdateNextDue();
+    DEBUG('i', "Cancelling interrupt %d: %s\n", id, 
+					found ? "done" : "not pending");
+    return found;
 }
 
 //----------------------------------------------------------------------
@@ -297,29 +671,28 @@ Interrupt::CheckIfDue(bool advanceClock)
 					// to invoke an interrupt handler
     if (DebugIsEnabled('i'))
 	DumpState();
-    PendingInterrupt *toOccur = 
-		(PendingInterrupt *)pending->SortedRemove(&when);
+    PendingInterrupt *first = pending->Front();
+    PendingInterrupt toOccur;
 
-    if (toOccur == NULL)		// no pending interrupts
+    if (first == NULL)			// no pending interrupts
 	return FALSE;			
+    when = first->when;
 
     if (advanceClock && when > stats->totalTicks) {	// advance the clock
 	stats->idleTicks += (when - stats->totalTicks);
 	stats->totalTicks = when;
-    } else if (when > stats->totalTicks) {	// not time yet, put it back
-	pending->SortedInsert(toOccur, when);
-	return FALSE;
+    } else if (when > stats->totalTicks) {	// not time yet; leave it
+	return FALSE;				// where it is
     }
 
 // Check if there is nothing more to do, and if so, quit
-    if ((status == IdleMode) && (toOccur->type == TimerInt) 
-				&& pending->IsEmpty()) {
-	 pending->SortedInsert(toOccur, when);
+    if ((status == IdleMode) && (first->type == TimerInt) 
+				&& (pending->NumPending() == 1))
 	 return FALSE;
-    }
+    pending->RemoveFront(&toOccur);
 
     DEBUG('i', "Invoking interrupt handler for the %s at time %d\n", 
-			intTypeNames[toOccur->type], toOccur->when);
+			intTypeNames[toOccur.type], toOccur.when);
 #ifdef USER_PROGRAM
     if (machine != NULL)
     	machine->DelayedLoad(0, 0);
@@ -328,10 +701,11 @@ Interrupt::CheckIfDue(bool advanceClock)
     status = SystemMode;			// whatever we were doing,
 						// we are now going to be
 						// running in the kernel
-    (*(toOccur->handler))(toOccur->arg);	// call the interrupt handler
+    (*(toOccur.handler))(toOccur.arg);		// call the interrupt handler
     status = old;				// restore the machine status
     inHandler = FALSE;
-    delete toOccur;
+    UpdateNextDue();				// (the handler may have
+						// scheduled another)
     return TRUE;
 }
 
@@ -363,7 +737,7 @@ Interrupt::DumpState()
 					intLevelNames[level]);
     printf("Pending interrupts:\n");
     fflush(stdout);
-    pending->Mapcar(PrintPending);
+    pending->Print(PrintPending);
     printf("End of pending interrupts\n");
     fflush(stdout);
 }
@@ -36,7 +36,7 @@
 #define INTERRUPT_H
 
 #include "copyright.h"
-#include "list.h"
+#include "utility.h"
 
 // Interrupts can be disabled (IntOff) or enabled (IntOn)
 enum IntStatus { IntOff, IntOn };
@@ -52,21 +52,78 @@ enum MachineStatus {IdleMode, SystemMode, UserMode};
 enum IntType { TimerInt, DiskInt, ConsoleWriteInt, ConsoleReadInt, 
 				NetworkSendInt, NetworkRecvInt};
 
+// UserTicksUntilDue's answer when there is nothing pending at all
+#define NoInterruptDue	0x3fffffff
+
+// When the next interrupt is due, if there is nothing pending at all
+#define NeverDue	0x7fffffff
+
 // The following class defines an interrupt that is scheduled
 // to occur in the future.  The internal data structures are
 // left public to make it simpler to manipulate.
 
 class PendingInterrupt {
   public:
-    PendingInterrupt(VoidFunctionPtr func, int param, int time, IntType kind);
-				// initialize an interrupt that will
-				// occur in the future
-
     VoidFunctionPtr handler;    // The function (in the hardware device
 				// emulator) to call when the interrupt occurs
     int arg;                    // The argument to the function.
     int when;			// When the interrupt is supposed to fire
     IntType type;		// for debugging
+
+    unsigned int seq;		// order of scheduling, so that interrupts
+				// due at the same time fire first come,
+				// first served
+    int heapPos;		// where in the heap, or -1 if not pending
+    int generation;		// bumped each time the slot is reused, so
+				// a stale id can't cancel the new occupant
+};
+
+// The following class defines the queue of pending interrupts: a
+// binary heap, ordered by (when, seq), of slots in a pool of
+// PendingInterrupts.  Inserting, removing the first interrupt, and
+// cancelling are all O(log n), and nothing is allocated per interrupt
+// -- slots are recycled, and the pool only grows (by doubling) when
+// more interrupts are pending at once than ever before.
+//
+// Each scheduled interrupt is named by an id, made of its slot and
+// the slot's generation.
+
+#define MaxPendingSlots	(1 << 16)	// slot numbers must fit in an id
+
+class PendingQueue {
+  public:
+    PendingQueue();
+    ~PendingQueue();
+
+    int Insert(VoidFunctionPtr handler, int arg, int when, IntType type);
+				// Add an interrupt; return its id
+    PendingInterrupt *Front();	// The first interrupt due (NULL if none);
+				// only valid until the next Insert
+    void RemoveFront(PendingInterrupt *copy);
+				// Remove the first interrupt, copying it
+				// out (its slot may be reused right away)
+    bool Cancel(int id);	// Remove an interrupt before it fires;
+				// FALSE if it already fired or was cancelled
+    int NumPending() { return numPending; }
+
+    void Print(VoidFunctionPtr func);
+				// Call "func" on each pending interrupt,
+				// in the order they will fire
+
+  private:
+    PendingInterrupt *pool;	// every slot, pending or free
+    int *heap;			// slot #'s of the pending interrupts
+    int *freeSlots;		// stack of unused slot #'s
+    int numPending, numFree;
+    int capacity;		// # of slots in the pool
+    unsigned int nextSeq;	// seq for the next interrupt scheduled
+
+    bool Earlier(int a, int b);	// does slot "a" fire before slot "b"?
+    void Place(int pos, int slot);	// put "slot" at heap[pos]
+    void SiftUp(int pos);
+    void SiftDown(int pos);
+    void RemoveAt(int pos);	// take heap[pos] out of the heap
+    void Grow();		// double the size of the pool
 };
 
 // The following class defines the data structures for the simulation
@@ -94,6 +151,8 @@ class Interrupt {
     
     void YieldOnReturn();		// cause a context switch on return 
 					// from an interrupt handler
+    void SwitchCPUOnReturn();		// likewise, give the next CPU
+					// its turn on return
 
     MachineStatus getStatus() { return status; } // idle, kernel, user
     void setStatus(MachineStatus st) { status = st; }
@@ -106,20 +165,40 @@ class Interrupt {
     // but they need to be public since they are called by the
     // hardware device simulators.
 
-    void Schedule(VoidFunctionPtr handler,// Schedule an interrupt to occur
+    int Schedule(VoidFunctionPtr handler,// Schedule an interrupt to occur
 	int arg, int when, IntType type);// at time ``when''.  This is called
     					// by the hardware device simulators.
+					// Returns an id for Cancel.
+
+    bool Cancel(int id);		// Unschedule an interrupt that hasn't
+					// fired yet
     
     void OneTick();       		// Advance simulated time
 
+    void UserTicks(int count);		// Advance simulated time by "count"
+					// user instructions at once, then
+					// do what OneTick would have done
+					// after the last of them
+
+    int UserTicksUntilDue();		// How many user instructions can
+					// run before the next pending
+					// interrupt is due?
+
   private:
     IntStatus level;		// are interrupts enabled or disabled?
-    List *pending;		// the list of interrupts scheduled
-				// to occur in the future
+    PendingQueue *pending;	// the interrupts scheduled to occur
+				// in the future
     bool inHandler;		// TRUE if we are running an interrupt handler
     bool yieldOnReturn; 	// TRUE if we are to context switch
 				// on return from the interrupt handler
+    bool switchOnReturn;	// ... or switch CPUs
     MachineStatus status;	// idle, kernel mode, user mode
+    int nextDue;		// when the first pending interrupt is due
+				// (NeverDue if none); until then, there
+				// is nothing to check on each tick
+    bool tracing;		// printing interrupt debug messages?
+				// if so, always do the full check, so
+				// the trace shows every tick
 
     // these functions are internal to the interrupt simulation code
 
@@ -128,6 +207,12 @@ class Interrupt {
 
     void ChangeLevel(IntStatus old, 	// SetLevel, without advancing the
 	IntStatus now);  		// simulated time
+
+    void UpdateNextDue();		// recompute nextDue from "pending"
+
+    void FireDueInterrupts(MachineStatus old);
+					// Run any interrupts due now, then
+					// context switch if one asked to
 };
 
 #endif // INTERRRUPT_H
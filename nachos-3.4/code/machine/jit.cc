@@ -0,0 +1,596 @@
+// jit.cc
+//	Routines to compile hot basic blocks of user code into calls
+//	to host routines specialized for each instruction, and to run
+//	them.  See jit.h.
+//
+//	Each routine below does exactly what the matching case in
+//	Machine::OneInstruction does, in the same order -- including
+//	the delayed load and the update of the program counters -- so
+//	that the two can be checked against each other (Machine::
+//	CheckCompiled, "nachos -jd").
+//
+//  DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "jit.h"
+#include "machine.h"
+#include "mipssim.h"
+#include "system.h"
+
+//----------------------------------------------------------------------
+// Retire, RetireLoad
+// 	Finish a compiled instruction, the way OneInstruction does:
+//	do any pending delayed load (and start a new one, for a load),
+//	keep R0 zero, and advance the program counters.
+//----------------------------------------------------------------------
+
+static inline void
+RetireLoad(unsigned int *r, int pcAfter, int nextReg, int nextValue)
+{
+    r[r[LoadReg]] = r[LoadValueReg];
+    r[LoadReg] = nextReg;
+    r[LoadValueReg] = nextValue;
+    r[0] = 0;
+    r[PrevPCReg] = r[PCReg];
+    r[PCReg] = r[NextPCReg];
+    r[NextPCReg] = pcAfter;
+}
+
+static inline void
+Retire(unsigned int *r, int pcAfter)
+{
+    RetireLoad(r, pcAfter, 0, 0);
+}
+
+//----------------------------------------------------------------------
+// JitAddress
+// 	Return where in mainMemory a user load or store of "size" bytes
+//	at "addr" goes, or NULL if it can't be done without an
+//	exception.
+//
+//	Most of the time the page is in the soft TLB.  Otherwise we go
+//	through Machine::Translate, which sets the use and dirty bits
+//	just as ReadMem or WriteMem would have, and enters the page in
+//	the soft TLB for next time.
+//----------------------------------------------------------------------
+
+static inline char *
+JitAddress(Machine *m, unsigned int addr, int size, bool writing)
+{
+    char *host = m->HostAddress(addr, size, writing);
+    int physAddr;
+
+    if (host != NULL)
+	return host;
+    if (m->Translate(addr, &physAddr, size, writing) != NoException)
+	return NULL;
+    return &m->mainMemory[physAddr];
+}
+
+//----------------------------------------------------------------------
+// Compiled instructions.  Each returns FALSE, without changing any
+// state, if the interpreter has to run the instruction instead.
+//----------------------------------------------------------------------
+
+#define NEXT(m)		((m)->registers[NextPCReg] + 4)
+
+// Register-to-register and immediate operations that can't trap.
+#define JIT_ALU(name, result)						\
+static bool								\
+name(Machine *m, JitOp *op)						\
+{									\
+    *op->d = (result);							\
+    Retire(m->registers, NEXT(m));					\
+    return TRUE;							\
+}
+
+JIT_ALU(JitAddu, *op->s + *op->t)
+JIT_ALU(JitAddiu, *op->s + op->imm)
+JIT_ALU(JitSubu, *op->s - *op->t)
+JIT_ALU(JitAnd, *op->s & *op->t)
+JIT_ALU(JitAndi, *op->s & op->imm)
+JIT_ALU(JitOr, *op->s | *op->t)
+JIT_ALU(JitOri, *op->s | op->imm)
+JIT_ALU(JitXor, *op->s ^ *op->t)
+JIT_ALU(JitXori, *op->s ^ op->imm)
+JIT_ALU(JitNor, ~(*op->s | *op->t))
+JIT_ALU(JitLui, op->imm)
+JIT_ALU(JitSlt, (*op->s < *op->t) ? 1 : 0)
+JIT_ALU(JitSlti, (*op->s < op->imm) ? 1 : 0)
+JIT_ALU(JitSltu, (*op->s < *op->t) ? 1 : 0)
+JIT_ALU(JitSltiu, (*op->s < op->imm) ? 1 : 0)
+JIT_ALU(JitSll, *op->t << op->imm)
+JIT_ALU(JitSllv, *op->t << (*op->s & 0x1f))
+JIT_ALU(JitSra, *op->t >> op->imm)
+JIT_ALU(JitSrav, *op->t >> (*op->s & 0x1f))
+JIT_ALU(JitSrl, (int) *op->t >> op->imm)
+JIT_ALU(JitSrlv, (int) *op->t >> (*op->s & 0x1f))
+JIT_ALU(JitMfhi, m->registers[HiReg])
+JIT_ALU(JitMflo, m->registers[LoReg])
+
+static bool
+JitAdd(Machine *m, JitOp *op)
+{
+    int sum = *op->s + *op->t;
+
+    if (!((*op->s ^ *op->t) & SIGN_BIT) && ((*op->s ^ sum) & SIGN_BIT))
+	return FALSE;			// overflow
+    *op->d = sum;
+    Retire(m->registers, NEXT(m));
+    return TRUE;
+}
+
+static bool
+JitAddi(Machine *m, JitOp *op)
+{
+    int sum = *op->s + op->imm;
+
+    if (!((*op->s ^ op->imm) & SIGN_BIT) && ((op->imm ^ sum) & SIGN_BIT))
+	return FALSE;			// overflow
+    *op->d = sum;
+    Retire(m->registers, NEXT(m));
+    return TRUE;
+}
+
+static bool
+JitSub(Machine *m, JitOp *op)
+{
+    int diff = *op->s - *op->t;
+
+    if (((*op->s ^ *op->t) & SIGN_BIT) && ((*op->s ^ diff) & SIGN_BIT))
+	return FALSE;			// overflow
+    *op->d = diff;
+    Retire(m->registers, NEXT(m));
+    return TRUE;
+}
+
+static bool
+JitMthi(Machine *m, JitOp *op)
+{
+    m->registers[HiReg] = *op->s;
+    Retire(m->registers, NEXT(m));
+    return TRUE;
+}
+
+static bool
+JitMtlo(Machine *m, JitOp *op)
+{
+    m->registers[LoReg] = *op->s;
+    Retire(m->registers, NEXT(m));
+    return TRUE;
+}
+
+static bool
+JitMult(Machine *m, JitOp *op)
+{
+    Mult(*op->s, *op->t, TRUE, &m->registers[HiReg], &m->registers[LoReg]);
+    Retire(m->registers, NEXT(m));
+    return TRUE;
+}
+
+static bool
+JitMultu(Machine *m, JitOp *op)
+{
+    Mult(*op->s, *op->t, FALSE, &m->registers[HiReg], &m->registers[LoReg]);
+    Retire(m->registers, NEXT(m));
+    return TRUE;
+}
+
+static bool
+JitDiv(Machine *m, JitOp *op)
+{
+    unsigned int *r = m->registers;
+
+    if (*op->t == 0) {
+	r[LoReg] = 0;
+	r[HiReg] = 0;
+    } else {
+	r[LoReg] = *op->s / *op->t;
+	r[HiReg] = *op->s % *op->t;
+    }
+    Retire(r, NEXT(m));
+    return TRUE;
+}
+
+static bool
+JitDivu(Machine *m, JitOp *op)
+{
+    unsigned int *r = m->registers;
+    unsigned int rs = *op->s, rt = *op->t;
+    int tmp;
+
+    if (rt == 0) {
+	r[LoReg] = 0;
+	r[HiReg] = 0;
+    } else {
+	tmp = rs / rt;
+	r[LoReg] = tmp;
+	tmp = rs % rt;
+	r[HiReg] = tmp;
+    }
+    Retire(r, NEXT(m));
+    return TRUE;
+}
+
+// Conditional branches; "imm" is the byte offset from the delay slot.
+#define JIT_BRANCH(name, taken)						\
+static bool								\
+name(Machine *m, JitOp *op)						\
+{									\
+    int pcAfter = NEXT(m);						\
+									\
+    if (taken)								\
+	pcAfter = m->registers[NextPCReg] + op->imm;			\
+    Retire(m->registers, pcAfter);					\
+    return TRUE;							\
+}
+
+JIT_BRANCH(JitBeq, *op->s == *op->t)
+JIT_BRANCH(JitBne, *op->s != *op->t)
+JIT_BRANCH(JitBgez, !(*op->s & SIGN_BIT))
+JIT_BRANCH(JitBltz, *op->s & SIGN_BIT)
+JIT_BRANCH(JitBgtz, *op->s > 0)
+JIT_BRANCH(JitBlez, *op->s <= 0)
+
+static bool
+JitBgezal(Machine *m, JitOp *op)
+{
+    m->registers[R31] = NEXT(m);
+    return JitBgez(m, op);
+}
+
+static bool
+JitBltzal(Machine *m, JitOp *op)
+{
+    m->registers[R31] = NEXT(m);
+    return JitBltz(m, op);
+}
+
+// Jumps; "imm" is the byte address within the current 256MB region.
+static bool
+JitJ(Machine *m, JitOp *op)
+{
+    Retire(m->registers, (NEXT(m) & 0xf0000000) | op->imm);
+    return TRUE;
+}
+
+static bool
+JitJal(Machine *m, JitOp *op)
+{
+    m->registers[R31] = NEXT(m);
+    return JitJ(m, op);
+}
+
+static bool
+JitJr(Machine *m, JitOp *op)
+{
+    Retire(m->registers, *op->s);
+    return TRUE;
+}
+
+static bool
+JitJalr(Machine *m, JitOp *op)
+{
+    *op->d = NEXT(m);
+    return JitJr(m, op);
+}
+
+// Loads.  The value goes into the load delay slot, not the register.
+static bool
+JitLb(Machine *m, JitOp *op)
+{
+    char *p = JitAddress(m, *op->s + op->imm, 1, FALSE);
+    int value;
+
+    if (p == NULL)
+	return FALSE;
+    value = *p;
+    if (value & 0x80)
+	value |= 0xffffff00;
+    else
+	value &= 0xff;
+    RetireLoad(m->registers, NEXT(m), op->loadReg, value);
+    return TRUE;
+}
+
+static bool
+JitLbu(Machine *m, JitOp *op)
+{
+    char *p = JitAddress(m, *op->s + op->imm, 1, FALSE);
+
+    if (p == NULL)
+	return FALSE;
+    RetireLoad(m->registers, NEXT(m), op->loadReg, *p & 0xff);
+    return TRUE;
+}
+
+static bool
+JitLh(Machine *m, JitOp *op)
+{
+    char *p = JitAddress(m, *op->s + op->imm, 2, FALSE);
+    int value;
+
+    if (p == NULL)
+	return FALSE;
+    value = ShortToHost(*(unsigned short *) p);
+    if (value & 0x8000)
+	value |= 0xffff0000;
+    else
+	value &= 0xffff;
+    RetireLoad(m->registers, NEXT(m), op->loadReg, value);
+    return TRUE;
+}
+
+static bool
+JitLhu(Machine *m, JitOp *op)
+{
+    char *p = JitAddress(m, *op->s + op->imm, 2, FALSE);
+
+    if (p == NULL)
+	return FALSE;
+    RetireLoad(m->registers, NEXT(m), op->loadReg,
+			ShortToHost(*(unsigned short *) p) & 0xffff);
+    return TRUE;
+}
+
+static bool
+JitLw(Machine *m, JitOp *op)
+{
+    char *p = JitAddress(m, *op->s + op->imm, 4, FALSE);
+
+    if (p == NULL)
+	return FALSE;
+    RetireLoad(m->registers, NEXT(m), op->loadReg,
+			WordToHost(*(unsigned int *) p));
+    return TRUE;
+}
+
+// Stores.  As in WriteMem, any predecoded copy of the page is dropped.
+static bool
+JitSb(Machine *m, JitOp *op)
+{
+    char *p = JitAddress(m, *op->s + op->imm, 1, TRUE);
+
+    if (p == NULL)
+	return FALSE;
+    m->InvalidateDecodeCache((p - m->mainMemory) / PageSize);
+    *p = (unsigned char) (*op->t & 0xff);
+    Retire(m->registers, NEXT(m));
+    return TRUE;
+}
+
+static bool
+JitSh(Machine *m, JitOp *op)
+{
+    char *p = JitAddress(m, *op->s + op->imm, 2, TRUE);
+
+    if (p == NULL)
+	return FALSE;
+    m->InvalidateDecodeCache((p - m->mainMemory) / PageSize);
+    *(unsigned short *) p = ShortToMachine((unsigned short) (*op->t & 0xffff));
+    Retire(m->registers, NEXT(m));
+    return TRUE;
+}
+
+static bool
+JitSw(Machine *m, JitOp *op)
+{
+    char *p = JitAddress(m, *op->s + op->imm, 4, TRUE);
+
+    if (p == NULL)
+	return FALSE;
+    m->InvalidateDecodeCache((p - m->mainMemory) / PageSize);
+    *(unsigned int *) p = WordToMachine(*op->t);
+    Retire(m->registers, NEXT(m));
+    return TRUE;
+}
+
+// Everything else (syscalls, lwl/lwr/swl/swr, reserved opcodes) is
+// left to the interpreter.
+static bool
+JitInterpret(Machine *m, JitOp *op)
+{
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// Machine::EnableJIT
+// 	Start compiling basic blocks once they get hot.
+//
+//	"check" -- if TRUE, run every compiled block a second time on
+//		the interpreter, and stop if the two disagree
+//----------------------------------------------------------------------
+
+void
+Machine::EnableJIT(bool check)
+{
+    jitEnabled = TRUE;
+    jitCheck = check;
+    if (check) {
+	jitBefore = new char[MemorySize];
+	jitAfter = new char[MemorySize];
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::CompileBlock
+// 	Compile each instruction of a basic block into a JitOp.
+//----------------------------------------------------------------------
+
+void
+Machine::CompileBlock(TranslationBlock *block)
+{
+    JitOp *ops = new JitOp[block->length];
+    Instruction *instr;
+    JitOp *op;
+
+    DEBUG('j', "Compiling %d instructions in physical page %d\n",
+		block->length, block->physPage);
+    for (int i = 0; i < block->length; i++) {
+	instr = &block->code[i];
+	op = &ops[i];
+	op->handler = JitInterpret;
+	op->d = &registers[instr->rd];
+	op->s = &registers[instr->rs];
+	op->t = &registers[instr->rt];
+	op->imm = instr->extra;
+	op->loadReg = instr->rt;
+	switch (instr->opCode) {
+	  case OP_ADD:	op->handler = JitAdd; break;
+	  case OP_ADDU:	op->handler = JitAddu; break;
+	  case OP_SUB:	op->handler = JitSub; break;
+	  case OP_SUBU:	op->handler = JitSubu; break;
+	  case OP_AND:	op->handler = JitAnd; break;
+	  case OP_OR:	op->handler = JitOr; break;
+	  case OP_XOR:	op->handler = JitXor; break;
+	  case OP_NOR:	op->handler = JitNor; break;
+	  case OP_SLT:	op->handler = JitSlt; break;
+	  case OP_SLTU:	op->handler = JitSltu; break;
+	  case OP_SLL:	op->handler = JitSll; break;
+	  case OP_SLLV:	op->handler = JitSllv; break;
+	  case OP_SRA:	op->handler = JitSra; break;
+	  case OP_SRAV:	op->handler = JitSrav; break;
+	  case OP_SRL:	op->handler = JitSrl; break;
+	  case OP_SRLV:	op->handler = JitSrlv; break;
+	  case OP_MFHI:	op->handler = JitMfhi; break;
+	  case OP_MFLO:	op->handler = JitMflo; break;
+	  case OP_MTHI:	op->handler = JitMthi; break;
+	  case OP_MTLO:	op->handler = JitMtlo; break;
+	  case OP_MULT:	op->handler = JitMult; break;
+	  case OP_MULTU: op->handler = JitMultu; break;
+	  case OP_DIV:	op->handler = JitDiv; break;
+	  case OP_DIVU:	op->handler = JitDivu; break;
+	  case OP_JR:	op->handler = JitJr; break;
+	  case OP_JALR:	op->handler = JitJalr; break;
+
+	  case OP_ADDI:	op->handler = JitAddi; op->d = op->t; break;
+	  case OP_ADDIU: op->handler = JitAddiu; op->d = op->t; break;
+	  case OP_SLTI:	op->handler = JitSlti; op->d = op->t; break;
+	  case OP_SLTIU: op->handler = JitSltiu; op->d = op->t; break;
+	  case OP_ANDI:
+	    op->handler = JitAndi; op->d = op->t; op->imm &= 0xffff; break;
+	  case OP_ORI:
+	    op->handler = JitOri; op->d = op->t; op->imm &= 0xffff; break;
+	  case OP_XORI:
+	    op->handler = JitXori; op->d = op->t; op->imm &= 0xffff; break;
+	  case OP_LUI:
+	    op->handler = JitLui; op->d = op->t; op->imm <<= 16; break;
+
+	  case OP_BEQ:	op->handler = JitBeq; break;
+	  case OP_BNE:	op->handler = JitBne; break;
+	  case OP_BGEZ:	op->handler = JitBgez; break;
+	  case OP_BGEZAL: op->handler = JitBgezal; break;
+	  case OP_BLTZ:	op->handler = JitBltz; break;
+	  case OP_BLTZAL: op->handler = JitBltzal; break;
+	  case OP_BGTZ:	op->handler = JitBgtz; break;
+	  case OP_BLEZ:	op->handler = JitBlez; break;
+	  case OP_J:	op->handler = JitJ; break;
+	  case OP_JAL:	op->handler = JitJal; break;
+
+	  case OP_LB:	op->handler = JitLb; break;
+	  case OP_LBU:	op->handler = JitLbu; break;
+	  case OP_LH:	op->handler = JitLh; break;
+	  case OP_LHU:	op->handler = JitLhu; break;
+	  case OP_LW:	op->handler = JitLw; break;
+	  case OP_SB:	op->handler = JitSb; break;
+	  case OP_SH:	op->handler = JitSh; break;
+	  case OP_SW:	op->handler = JitSw; break;
+	}
+	switch (instr->opCode) {	// branch offsets and jump targets
+	  case OP_BEQ: case OP_BNE: case OP_BGEZ: case OP_BGEZAL:
+	  case OP_BLTZ: case OP_BLTZAL: case OP_BGTZ: case OP_BLEZ:
+	  case OP_J: case OP_JAL:
+	    op->imm = IndexToAddr(op->imm);
+	    break;
+	}
+    }
+    block->compiled = ops;
+}
+
+//----------------------------------------------------------------------
+// Machine::RunCompiled
+// 	Run the first "n" instructions of a compiled basic block.  Stop
+//	early at an instruction the compiled code can't handle, or if the
+//	block writes to its own page.
+//
+//	Returns the number of instructions run; the caller has the
+//	interpreter pick up from there.
+//----------------------------------------------------------------------
+
+int
+Machine::RunCompiled(TranslationBlock *block, int n)
+{
+    JitOp *op = block->compiled;
+    int i;
+
+    if (jitCheck)
+	return CheckCompiled(block, n);
+    for (i = 0; i < n; i++, op++) {
+	if (!(*op->handler)(this, op))
+	    break;
+	if (!decodeValid[block->physPage]) {	// self-modifying code
+	    i++;
+	    break;
+	}
+    }
+    return i;
+}
+
+//----------------------------------------------------------------------
+// Machine::CheckCompiled
+// 	Like RunCompiled, but then undo the effects of the compiled code,
+//	run the same instructions again on the interpreter, and make sure
+//	that the registers and all of memory come out the same.  Used to
+//	test the compiler ("nachos -jd").
+//----------------------------------------------------------------------
+
+int
+Machine::CheckCompiled(TranslationBlock *block, int n)
+{
+    unsigned int before[NumTotalRegs], after[NumTotalRegs];
+    JitOp *op = block->compiled;
+    int i, j;
+
+    bcopy(registers, before, sizeof(registers));
+    bcopy(mainMemory, jitBefore, MemorySize);
+    for (i = 0; i < n; i++, op++) {
+	if (!(*op->handler)(this, op))
+	    break;
+	if (!decodeValid[block->physPage]) {
+	    i++;
+	    break;
+	}
+    }
+    bcopy(registers, after, sizeof(registers));
+    bcopy(mainMemory, jitAfter, MemorySize);
+
+    bcopy(before, registers, sizeof(registers));
+    bcopy(jitBefore, mainMemory, MemorySize);
+    for (j = 0; j < i; j++)
+	if (!OneInstruction(&block->code[j])) {
+	    printf("JIT check: instruction at 0x%x trapped in the interpreter "
+			"but not in compiled code\n", registers[PCReg]);
+	    ASSERT(FALSE);
+	}
+
+    for (j = 0; j < NumTotalRegs; j++)
+	if (registers[j] != after[j]) {
+	    printf("JIT check: block at 0x%x, %d instructions: register %d "
+			"is 0x%x, compiled code gave 0x%x\n", before[PCReg], i,
+			j, registers[j], after[j]);
+	    ASSERT(FALSE);
+	}
+    for (j = 0; j < MemorySize; j++)
+	if (mainMemory[j] != jitAfter[j]) {
+	    printf("JIT check: block at 0x%x, %d instructions: byte at "
+			"physical address 0x%x is 0x%x, compiled code gave "
+			"0x%x\n", before[PCReg], i, j, mainMemory[j] & 0xff,
+			jitAfter[j] & 0xff);
+	    ASSERT(FALSE);
+	}
+    return i;
+}
@@ -0,0 +1,53 @@
+// jit.h
+//	Data structures for compiling hot basic blocks of user code.
+//
+//	A basic block that has been run JitThreshold times is compiled
+//	into an array of JitOps, one per MIPS instruction.  Each JitOp
+//	points to a host routine specialized for its one opcode, with the
+//	register operands already turned into pointers into
+//	machine->registers, and the immediate already masked or shifted.
+//	Running a compiled block is then just a call through each op in
+//	turn: no fetch, no decode, no dispatch on the opcode.
+//
+//	Compiled code never traps to the kernel.  When an op can't finish
+//	on its own -- an overflow, an unaligned or unmapped address, an
+//	opcode we don't compile -- it returns FALSE before changing any
+//	state, and the interpreter runs that instruction instead (raising
+//	the exception, if there is one).  So the kernel can't tell
+//	whether a given instruction was compiled or interpreted.
+//
+//  DO NOT CHANGE -- part of the machine emulation
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef JIT_H
+#define JIT_H
+
+#include "copyright.h"
+#include "utility.h"
+
+#define JitThreshold	50	// compile a block once it has run
+				// this many times
+
+class Machine;
+class JitOp;
+
+typedef bool (*JitHandler)(Machine *m, JitOp *op);
+				// run one compiled instruction; return
+				// FALSE to have the interpreter run it
+
+// The following class defines one compiled MIPS instruction.
+
+class JitOp {
+  public:
+    JitHandler handler;		// host routine for this opcode
+    unsigned int *d;		// destination register
+    unsigned int *s, *t;	// source registers (rs and rt)
+    unsigned int imm;		// immediate, shift amount, or target
+    int loadReg;		// register # a load writes (for the
+				// load delay slot)
+};
+
+#endif // JIT_H
@@ -18,6 +18,54 @@ static const char* exceptionNames[] = { "no exception", "syscall",
 				"bus error", "address error", "overflow",
 				"illegal instruction" };
 
+// The geometry of physical memory (see SetMemorySize).
+int PageSize = DefaultPageSize;
+int PageShift = 7;			// log2(DefaultPageSize)
+int NumPhysPages = DefaultNumPhysPages;
+int TLBSize = DefaultTLBSize;
+int TLBWays = DefaultTLBWays;
+int TLBSets = DefaultTLBSize / DefaultTLBWays;
+
+//----------------------------------------------------------------------
+// SetMemorySize
+// 	Choose the page size and the size of physical memory.  Must be
+//	called, if at all, before the Machine is created.
+//
+//	"pageSize" -- bytes per page; a power of two, at least MinPageSize
+//	"memorySize" -- bytes of physical memory; a multiple of "pageSize"
+//----------------------------------------------------------------------
+
+void
+SetMemorySize(int pageSize, int memorySize)
+{
+    ASSERT((pageSize >= MinPageSize) && ((pageSize & (pageSize - 1)) == 0));
+    ASSERT((memorySize >= pageSize) && ((memorySize % pageSize) == 0));
+    PageSize = pageSize;
+    for (PageShift = 0; (1 << PageShift) < pageSize; PageShift++)
+	;
+    NumPhysPages = memorySize / pageSize;
+}
+
+//----------------------------------------------------------------------
+// SetTLBSize
+// 	Choose the shape of the TLB.  Like SetMemorySize, this must come
+//	before the Machine is created.
+//
+//	"size" -- # of entries
+//	"ways" -- # of entries in each set; "size" / "ways" must be a
+//		power of two (ways == size makes it fully associative)
+//----------------------------------------------------------------------
+
+void
+SetTLBSize(int size, int ways)
+{
+    ASSERT((ways > 0) && (size >= ways) && ((size % ways) == 0));
+    TLBSize = size;
+    TLBWays = ways;
+    TLBSets = size / ways;
+    ASSERT((TLBSets & (TLBSets - 1)) == 0);
+}
+
 //----------------------------------------------------------------------
 // CheckEndian
 // 	Check to be sure that the host really uses the format it says it 
@@ -61,6 +109,21 @@ Machine::Machine(bool debug)
     mainMemory = new char[MemorySize];
     for (i = 0; i < MemorySize; i++)
       	mainMemory[i] = 0;
+    decodeCache = new Instruction *[NumPhysPages];
+    decodeValid = new bool[NumPhysPages];
+    blockCache = new TranslationBlock *[NumPhysPages];
+    for (i = 0; i < NumPhysPages; i++) {
+	decodeCache[i] = NULL;
+	decodeValid[i] = FALSE;
+	blockCache[i] = NULL;
+    }
+    ticksOwed = 0;
+    jitEnabled = jitCheck = FALSE;
+    jitBefore = jitAfter = NULL;
+    profile = NULL;
+    tlbHits = 0;
+    asid = 0;
+    FlushSoftTLB();
 #ifdef USE_TLB
     tlb = new TranslationEntry[TLBSize];
     for (i = 0; i < TLBSize; i++)
@@ -83,10 +146,61 @@ Machine::Machine(bool debug)
 Machine::~Machine()
 {
     delete [] mainMemory;
+    for (int i = 0; i < NumPhysPages; i++) {
+	if (decodeCache[i] != NULL)
+	    delete [] decodeCache[i];
+	if (blockCache[i] != NULL) {
+	    for (int j = 0; j < PageSize / 4; j++)
+		if (blockCache[i][j].compiled != NULL)
+		    delete [] blockCache[i][j].compiled;
+	    delete [] blockCache[i];
+	}
+    }
+    delete [] decodeCache;
+    delete [] decodeValid;
+    delete [] blockCache;
+    if (jitBefore != NULL) {
+	delete [] jitBefore;
+	delete [] jitAfter;
+    }
     if (tlb != NULL)
         delete [] tlb;
 }
 
+//----------------------------------------------------------------------
+// Machine::InvalidateDecodeCache
+// 	Throw away the predecoded instructions for a physical page, so
+//	that the next fetch from the page decodes it again.  Called
+//	whenever the contents of the page change.
+//
+//	"physPage" -- the physical page number
+//----------------------------------------------------------------------
+
+void
+Machine::InvalidateDecodeCache(int physPage)
+{
+    ASSERT((physPage >= 0) && (physPage < NumPhysPages));
+    decodeValid[physPage] = FALSE;
+}
+
+//----------------------------------------------------------------------
+// Machine::FlushSoftTLB
+// 	Forget every page in the soft TLB, so that the next access to
+//	each page goes through Translate.  Must be called whenever the
+//	page table (or TLB) changes, or the kernel clears a use or dirty
+//	bit, since the soft TLB only holds pages whose bits are set.
+//----------------------------------------------------------------------
+
+void
+Machine::FlushSoftTLB()
+{
+    for (int i = 0; i < SoftTLBSize; i++) {
+	softTLB[i].readTag = (unsigned) -1;
+	softTLB[i].writeTag = (unsigned) -1;
+	softTLB[i].page = NULL;
+    }
+}
+
 //----------------------------------------------------------------------
 // Machine::RaiseException
 // 	Transfer control to the Nachos kernel from user mode, because
@@ -103,6 +217,11 @@ Machine::RaiseException(ExceptionType which, int badVAddr)
     DEBUG('m', "Exception: %s\n", exceptionNames[which]);
     
 //  ASSERT(interrupt->getStatus() == UserMode);
+    if (ticksOwed > 0) {		// charge for the instructions that
+	int owed = ticksOwed;		// ran earlier in the block, so the
+	ticksOwed = 0;			// kernel sees the right time
+	interrupt->UserTicks(owed);
+    }
     registers[BadVAddrReg] = badVAddr;
     DelayedLoad(0, 0);			// finish anything in progress
     interrupt->setStatus(SystemMode);
@@ -25,16 +25,40 @@
 #include "utility.h"
 #include "translate.h"
 #include "disk.h"
+#include "jit.h"
 
-// Definitions related to the size, and format of user memory
+// Definitions related to the size, and format of user memory.
+// The page size and the amount of physical memory are chosen when
+// Nachos starts up ("-pagesize" and "-mem"), before the Machine is
+// created; see SetMemorySize.
 
-#define PageSize 	SectorSize 	// set the page size equal to
+#define DefaultPageSize	SectorSize 	// set the page size equal to
 					// the disk sector size, for
 					// simplicity
+#define DefaultNumPhysPages 32
+#define MinPageSize	16		// so a page holds a few instructions
 
-#define NumPhysPages    32
+extern int PageSize;			// bytes per page (a power of two)
+extern int PageShift;			// log2(PageSize)
+extern int NumPhysPages;		// # of physical page frames
 #define MemorySize 	(NumPhysPages * PageSize)
-#define TLBSize		4		// if there is a TLB, make it small
+
+extern void SetMemorySize(int pageSize, int memorySize);
+					// choose the page size, and the
+					// amount of physical memory, in bytes
+
+// The TLB (with USE_TLB) is set-associative: a virtual page can only
+// be cached in the TLBWays entries of set (vpn % TLBSets).  Its shape
+// is also chosen at startup ("-tlb"); see SetTLBSize.
+
+#define DefaultTLBSize	4		// if there is a TLB, make it small
+#define DefaultTLBWays	4		// (and fully associative)
+
+extern int TLBSize;			// # of TLB entries
+extern int TLBWays;			// entries per set
+extern int TLBSets;			// # of sets (a power of two)
+
+extern void SetTLBSize(int size, int ways);
 
 enum ExceptionType { NoException,           // Everything ok!
 		     SyscallException,      // A program executed a system call.
@@ -78,6 +102,8 @@ enum ExceptionType { NoException,           // Everything ok!
 //	    registers to act on
 //	    any immediate operand value
 
+class UserProfile;
+
 class Instruction {
   public:
     void Decode();	// decode the binary representation of the instruction
@@ -91,6 +117,65 @@ class Instruction {
                      // Immediates are sign-extended.
 };
 
+// The following class defines a basic block of user code: a run of 
+// instructions in one physical page that always execute one after the
+// other.  A block ends with the delay slot of the first branch or jump
+// in it, with an instruction that always traps (syscall, reserved or
+// unimplemented opcodes), or at the end of the page.
+//
+// Blocks are found the first time control reaches them, and live
+// alongside the predecoded copy of their page; when the page is
+// decoded again, its blocks are forgotten as well.  Each block
+// remembers the last couple of blocks that followed it in the same
+// page, so that a loop can go from block to block without looking 
+// anything up.
+//
+// Once a block has run often enough, it is also compiled (see jit.h).
+
+class TranslationBlock {
+  public:
+    Instruction *code;		// first instruction, in the predecode cache
+    int length;			// # of instructions; 0 if not found yet
+    int physPage;		// the physical page holding the block
+    int branch;			// index of the branch or jump it ends
+				// with, if any; else -1
+
+    TranslationBlock *next[2];	// blocks that were executed after this
+    int nextPC[2];		// one, and the PC at which each starts
+    int lastLinked;		// which of the two was filled in last
+
+    int execCount;		// # of times the block has been entered
+    JitOp *compiled;		// compiled code, or NULL if not yet
+
+    TranslationBlock *Successor(int pc) {	// chained block for "pc"
+	if (nextPC[0] == pc) return next[0];
+	if (nextPC[1] == pc) return next[1];
+	return NULL;
+    }
+};
+
+// The following class defines one entry of the "soft TLB": a small,
+// direct-mapped cache, indexed by virtual page number, of where in 
+// mainMemory each recently used virtual page lives.  It lets ReadMem
+// and WriteMem skip Translate in the common case, with one compare.
+//
+// A page is entered for reading only once Translate has set its use
+// bit, and for writing only once Translate has set its dirty bit (and
+// if it isn't read-only), so the first read and the first write of a
+// page still go through Translate and set those bits.  The kernel
+// must call Machine::FlushSoftTLB whenever it changes a translation
+// or clears a use or dirty bit behind the machine's back.
+
+#define SoftTLBSize	64	// must be a power of two
+
+class SoftTLBEntry {
+  public:
+    unsigned int readTag;	// virtual address of the page, if it
+				// may be read directly; else -1
+    unsigned int writeTag;	// ditto, for writing
+    char *page;			// the page, in mainMemory
+};
+
 // The following class defines the simulated host workstation hardware, as 
 // seen by user programs -- the CPU registers, main memory, etc.
 // User programs shouldn't be able to tell that they are running on our 
@@ -101,8 +186,8 @@ class Instruction {
 // If we were to implement more of the UNIX system calls, we ought to be
 // able to run Nachos on top of Nachos!
 //
-// The procedures in this class are defined in machine.cc, mipssim.cc, and
-// translate.cc.
+// The procedures in this class are defined in machine.cc, mipssim.cc,
+// translate.cc, and jit.cc.
 
 class Machine {
   public:
@@ -118,11 +203,23 @@ class Machine {
     void WriteRegister(int num, int value);
 				// store a value into a CPU register
 
+    void EnableJIT(bool check);	// compile hot blocks of user code; if
+				// "check", also run each compiled block
+				// on the interpreter and compare
+
 
 // Routines internal to the machine simulation -- DO NOT call these 
 
-    void OneInstruction(Instruction *instr); 	
-    				// Run one instruction of a user program.
+    Instruction *FetchInstruction();	// Fetch the decoded instruction at
+					// the PC, from the predecode cache.
+					// Returns NULL on an exception.
+    bool OneInstruction(Instruction *instr); 	
+    				// Run one (already decoded) instruction
+				// of a user program.  Returns FALSE if
+				// it trapped to the kernel.
+    void RunBlocks();		// Run user code a basic block at a time,
+				// until the next interrupt is due or
+				// the program traps
     void DelayedLoad(int nextReg, int nextVal);  	
 				// Do a pending delayed load (modifying a reg)
     
@@ -132,6 +229,26 @@ class Machine {
 				// memory (at addr).  Return FALSE if a 
 				// correct translation couldn't be found.
     
+    char *HostAddress(int addr, int size, bool writing) {
+	unsigned int tag = ((unsigned) addr & ~(PageSize - 1))
+				| ((unsigned) addr & (size - 1));
+	SoftTLBEntry *e = &softTLB[((unsigned) addr >> PageShift) 
+					& (SoftTLBSize - 1)];
+
+	if ((writing ? e->writeTag : e->readTag) != tag)
+	    return NULL;
+#ifdef USE_TLB
+	tlbHits++;			// (only pages in the TLB get here)
+#endif
+	return e->page + ((unsigned) addr & (PageSize - 1));
+    }
+				// Look up a 1, 2, or 4 byte access in 
+				// the soft TLB; return where it is in
+				// mainMemory, or NULL if the access has
+				// to go through Translate.  (An unaligned
+				// access never matches.)
+    void FlushSoftTLB();	// Empty the soft TLB
+
     ExceptionType Translate(int virtAddr, int* physAddr, int size,bool writing);
     				// Translate an address, and check for 
 				// alignment.  Set the use and dirty bits in 
@@ -139,6 +256,13 @@ class Machine {
     				// and return an exception code if the 
 				// translation couldn't be completed.
 
+    void InvalidateDecodeCache(int physPage);
+				// Forget any predecoded instructions for
+				// a physical page, because its contents
+				// are about to change.  Kernel code that
+				// writes user code into mainMemory
+				// directly must call this.
+
     void RaiseException(ExceptionType which, int badVAddr);
 				// Trap to the Nachos kernel, because of a
 				// system call or other exception.  
@@ -178,11 +302,57 @@ class Machine {
 
     TranslationEntry *tlb;		// this pointer should be considered 
 					// "read-only" to Nachos kernel code
+    TranslationEntry *TLBSet(unsigned int vpn) {
+	return &tlb[(vpn & (TLBSets - 1)) * TLBWays];
+    }					// the TLBWays entries that can
+					// hold a translation for "vpn"
+    int tlbHits;			// translations found in the TLB; a 
+					// performance counter, which the 
+					// kernel reads and resets
+    int asid;				// the running address space's
+					// identifier; only TLB entries
+					// tagged with it are used
 
     TranslationEntry *pageTable;
     unsigned int pageTableSize;
 
+    UserProfile *profile;	// counts for the running address space,
+				// or NULL if it isn't being profiled
+
   private:
+// The predecode cache.  Instructions are decoded a physical page at a
+// time, the first time any word in the page is fetched, and the
+// decoded copy is reused until the page is written -- by a user store
+// (WriteMem) or by the kernel (InvalidateDecodeCache).  Loops like
+// the ones in test/matmult.c and test/sort.c thus decode each
+// instruction once, instead of once per iteration.
+
+    Instruction **decodeCache;	// per physical page: decoded copy of
+				// each word, or NULL if never decoded
+    bool *decodeValid;		// per physical page: is decodeCache
+				// up to date with mainMemory?
+    void DecodePage(int physPage);	// (re)fill decodeCache for a page
+
+    TranslationBlock **blockCache;	// per physical page: one block
+				// per word, indexed by starting word
+    TranslationBlock *FindBlock();	// the block at the PC, found on 
+				// the spot if need be; NULL if
+				// the fetch trapped
+    int ticksOwed;		// instructions of the current block that
+				// have run but not been charged yet
+
+    bool jitEnabled;		// compile blocks once they are hot?
+    bool jitCheck;		// check compiled code against the
+				// interpreter?
+    char *jitBefore, *jitAfter;	// copies of mainMemory, for the check
+    void CompileBlock(TranslationBlock *block);
+    int RunCompiled(TranslationBlock *block, int n);
+    int CheckCompiled(TranslationBlock *block, int n);
+				// run (and check) up to "n" compiled
+				// instructions; returns how many ran
+
+    SoftTLBEntry softTLB[SoftTLBSize];	// filled in by Translate
+
     bool singleStep;		// drop back into the debugger after each
 				// simulated instruction
     int runUntilTime;		// drop back into the debugger when simulated
@@ -197,7 +367,8 @@ extern void ExceptionHandler(ExceptionType which);
 
 // Routines for converting Words and Short Words to and from the
 // simulated machine's format of little endian.  If the host machine
-// is little endian (DEC and Intel), these end up being NOPs.
+// is little endian (DEC and Intel), these end up being NOPs -- they
+// are inline, so that the compiler can drop them entirely.
 //
 // What is stored in each format:
 //	host byte ordering:
@@ -206,9 +377,36 @@ extern void ExceptionHandler(ExceptionType which);
 //	simulated machine byte ordering:
 //	   contents of main memory
 
-unsigned int WordToHost(unsigned int word);
-unsigned short ShortToHost(unsigned short shortword);
-unsigned int WordToMachine(unsigned int word);
-unsigned short ShortToMachine(unsigned short shortword);
+inline unsigned int
+WordToHost(unsigned int word) {
+#ifdef HOST_IS_BIG_ENDIAN
+	 register unsigned long result;
+	 result = (word >> 24) & 0x000000ff;
+	 result |= (word >> 8) & 0x0000ff00;
+	 result |= (word << 8) & 0x00ff0000;
+	 result |= (word << 24) & 0xff000000;
+	 return result;
+#else 
+	 return word;
+#endif /* HOST_IS_BIG_ENDIAN */
+}
+
+inline unsigned short
+ShortToHost(unsigned short shortword) {
+#ifdef HOST_IS_BIG_ENDIAN
+	 register unsigned short result;
+	 result = (shortword << 8) & 0xff00;
+	 result |= (shortword >> 8) & 0x00ff;
+	 return result;
+#else 
+	 return shortword;
+#endif /* HOST_IS_BIG_ENDIAN */
+}
+
+inline unsigned int
+WordToMachine(unsigned int word) { return WordToHost(word); }
+
+inline unsigned short
+ShortToMachine(unsigned short shortword) { return ShortToHost(shortword); }
 
 #endif // MACHINE_H
\ No newline at end of file
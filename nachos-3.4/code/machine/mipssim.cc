@@ -15,14 +15,124 @@
 #include "machine.h"
 #include "mipssim.h"
 #include "system.h"
+#include "profile.h"
 
-static void Mult(int a, int b, bool signedArith, unsigned int* hiPtr, unsigned int* loPtr);
+// The tables used to decode instructions, and to print them out for
+// debugging (see mipssim.h).  They are here, rather than in the header,
+// so that other files can include mipssim.h for the opcodes.  The
+// profiler uses opStrings too, for the names of the opcodes.
+
+static OpInfo opTable[] = {
+    {SPECIAL, RFMT}, {BCOND, IFMT}, {OP_J, JFMT}, {OP_JAL, JFMT},
+    {OP_BEQ, IFMT}, {OP_BNE, IFMT}, {OP_BLEZ, IFMT}, {OP_BGTZ, IFMT},
+    {OP_ADDI, IFMT}, {OP_ADDIU, IFMT}, {OP_SLTI, IFMT}, {OP_SLTIU, IFMT},
+    {OP_ANDI, IFMT}, {OP_ORI, IFMT}, {OP_XORI, IFMT}, {OP_LUI, IFMT},
+    {OP_UNIMP, IFMT}, {OP_UNIMP, IFMT}, {OP_UNIMP, IFMT}, {OP_UNIMP, IFMT},
+    {OP_RES, IFMT}, {OP_RES, IFMT}, {OP_RES, IFMT}, {OP_RES, IFMT},
+    {OP_RES, IFMT}, {OP_RES, IFMT}, {OP_RES, IFMT}, {OP_RES, IFMT},
+    {OP_RES, IFMT}, {OP_RES, IFMT}, {OP_RES, IFMT}, {OP_RES, IFMT},
+    {OP_LB, IFMT}, {OP_LH, IFMT}, {OP_LWL, IFMT}, {OP_LW, IFMT},
+    {OP_LBU, IFMT}, {OP_LHU, IFMT}, {OP_LWR, IFMT}, {OP_RES, IFMT},
+    {OP_SB, IFMT}, {OP_SH, IFMT}, {OP_SWL, IFMT}, {OP_SW, IFMT},
+    {OP_RES, IFMT}, {OP_RES, IFMT}, {OP_SWR, IFMT}, {OP_RES, IFMT},
+    {OP_UNIMP, IFMT}, {OP_UNIMP, IFMT}, {OP_UNIMP, IFMT}, {OP_UNIMP, IFMT},
+    {OP_RES, IFMT}, {OP_RES, IFMT}, {OP_RES, IFMT}, {OP_RES, IFMT},
+    {OP_UNIMP, IFMT}, {OP_UNIMP, IFMT}, {OP_UNIMP, IFMT}, {OP_UNIMP, IFMT},
+    {OP_RES, IFMT}, {OP_RES, IFMT}, {OP_RES, IFMT}, {OP_RES, IFMT}
+};
+
+/*
+ * The table below is used to convert the "funct" field of SPECIAL
+ * instructions into the "opCode" field of a MemWord.
+ */
+
+static int specialTable[] = {
+    OP_SLL, OP_RES, OP_SRL, OP_SRA, OP_SLLV, OP_RES, OP_SRLV, OP_SRAV,
+    OP_JR, OP_JALR, OP_RES, OP_RES, OP_SYSCALL, OP_UNIMP, OP_RES, OP_RES,
+    OP_MFHI, OP_MTHI, OP_MFLO, OP_MTLO, OP_RES, OP_RES, OP_RES, OP_RES,
+    OP_MULT, OP_MULTU, OP_DIV, OP_DIVU, OP_RES, OP_RES, OP_RES, OP_RES,
+    OP_ADD, OP_ADDU, OP_SUB, OP_SUBU, OP_AND, OP_OR, OP_XOR, OP_NOR,
+    OP_RES, OP_RES, OP_SLT, OP_SLTU, OP_RES, OP_RES, OP_RES, OP_RES,
+    OP_RES, OP_RES, OP_RES, OP_RES, OP_RES, OP_RES, OP_RES, OP_RES,
+    OP_RES, OP_RES, OP_RES, OP_RES, OP_RES, OP_RES, OP_RES, OP_RES
+};
+
+struct OpString opStrings[] = {
+	{"Shouldn't happen", {NONE, NONE, NONE}},
+	{"ADD r%d,r%d,r%d", {RD, RS, RT}},
+	{"ADDI r%d,r%d,%d", {RT, RS, EXTRA}},
+	{"ADDIU r%d,r%d,%d", {RT, RS, EXTRA}},
+	{"ADDU r%d,r%d,r%d", {RD, RS, RT}},
+	{"AND r%d,r%d,r%d", {RD, RS, RT}},
+	{"ANDI r%d,r%d,%d", {RT, RS, EXTRA}},
+	{"BEQ r%d,r%d,%d", {RS, RT, EXTRA}},
+	{"BGEZ r%d,%d", {RS, EXTRA, NONE}},
+	{"BGEZAL r%d,%d", {RS, EXTRA, NONE}},
+	{"BGTZ r%d,%d", {RS, EXTRA, NONE}},
+	{"BLEZ r%d,%d", {RS, EXTRA, NONE}},
+	{"BLTZ r%d,%d", {RS, EXTRA, NONE}},
+	{"BLTZAL r%d,%d", {RS, EXTRA, NONE}},
+	{"BNE r%d,r%d,%d", {RS, RT, EXTRA}},
+	{"Shouldn't happen", {NONE, NONE, NONE}},
+	{"DIV r%d,r%d", {RS, RT, NONE}},
+	{"DIVU r%d,r%d", {RS, RT, NONE}},
+	{"J %d", {EXTRA, NONE, NONE}},
+	{"JAL %d", {EXTRA, NONE, NONE}},
+	{"JALR r%d,r%d", {RD, RS, NONE}},
+	{"JR r%d,r%d", {RD, RS, NONE}},
+	{"LB r%d,%d(r%d)", {RT, EXTRA, RS}},
+	{"LBU r%d,%d(r%d)", {RT, EXTRA, RS}},
+	{"LH r%d,%d(r%d)", {RT, EXTRA, RS}},
+	{"LHU r%d,%d(r%d)", {RT, EXTRA, RS}},
+	{"LUI r%d,%d", {RT, EXTRA, NONE}},
+	{"LW r%d,%d(r%d)", {RT, EXTRA, RS}},
+	{"LWL r%d,%d(r%d)", {RT, EXTRA, RS}},
+	{"LWR r%d,%d(r%d)", {RT, EXTRA, RS}},
+	{"Shouldn't happen", {NONE, NONE, NONE}},
+	{"MFHI r%d", {RD, NONE, NONE}},
+	{"MFLO r%d", {RD, NONE, NONE}},
+	{"Shouldn't happen", {NONE, NONE, NONE}},
+	{"MTHI r%d", {RS, NONE, NONE}},
+	{"MTLO r%d", {RS, NONE, NONE}},
+	{"MULT r%d,r%d", {RS, RT, NONE}},
+	{"MULTU r%d,r%d", {RS, RT, NONE}},
+	{"NOR r%d,r%d,r%d", {RD, RS, RT}},
+	{"OR r%d,r%d,r%d", {RD, RS, RT}},
+	{"ORI r%d,r%d,%d", {RT, RS, EXTRA}},
+	{"RFE", {NONE, NONE, NONE}},
+	{"SB r%d,%d(r%d)", {RT, EXTRA, RS}},
+	{"SH r%d,%d(r%d)", {RT, EXTRA, RS}},
+	{"SLL r%d,r%d,%d", {RD, RT, EXTRA}},
+	{"SLLV r%d,r%d,r%d", {RD, RT, RS}},
+	{"SLT r%d,r%d,r%d", {RD, RS, RT}},
+	{"SLTI r%d,r%d,%d", {RT, RS, EXTRA}},
+	{"SLTIU r%d,r%d,%d", {RT, RS, EXTRA}},
+	{"SLTU r%d,r%d,r%d", {RD, RS, RT}},
+	{"SRA r%d,r%d,%d", {RD, RT, EXTRA}},
+	{"SRAV r%d,r%d,r%d", {RD, RT, RS}},
+	{"SRL r%d,r%d,%d", {RD, RT, EXTRA}},
+	{"SRLV r%d,r%d,r%d", {RD, RT, RS}},
+	{"SUB r%d,r%d,r%d", {RD, RS, RT}},
+	{"SUBU r%d,r%d,r%d", {RD, RS, RT}},
+	{"SW r%d,%d(r%d)", {RT, EXTRA, RS}},
+	{"SWL r%d,%d(r%d)", {RT, EXTRA, RS}},
+	{"SWR r%d,%d(r%d)", {RT, EXTRA, RS}},
+	{"XOR r%d,r%d,r%d", {RD, RS, RT}},
+	{"XORI r%d,r%d,%d", {RT, RS, EXTRA}},
+	{"SYSCALL", {NONE, NONE, NONE}},
+	{"Unimplemented", {NONE, NONE, NONE}},
+	{"Reserved", {NONE, NONE, NONE}}
+      };
 
 //----------------------------------------------------------------------
 // Machine::Run
 // 	Simulate the execution of a user-level program on Nachos.
 //	Called by the kernel when the program starts up; never returns.
 //
+//	Normally user code is run a basic block at a time (RunBlocks).
+//	When single-stepping, or tracing every instruction, we go back
+//	to running one instruction per tick.
+//
 //	This routine is re-entrant, in that it can be called multiple
 //	times concurrently -- one for each thread executing user code.
 //----------------------------------------------------------------------
@@ -30,20 +140,202 @@ static void Mult(int a, int b, bool signedArith, unsigned int* hiPtr, unsigned i
 void
 Machine::Run()
 {
-    Instruction *instr = new Instruction;  // storage for decoded instruction
+    Instruction *instr;		// decoded instruction, from the predecode
+				// cache
+    int pc;
 
     if(DebugIsEnabled('m'))
         printf("Starting thread \"%s\" at time %d\n",
 	       currentThread->getName(), stats->totalTicks);
     interrupt->setStatus(UserMode);
     for (;;) {
-        OneInstruction(instr);
+	if (!singleStep && !DebugIsEnabled('m')) {
+	    RunBlocks();
+	    continue;
+	}
+	pc = registers[PCReg];
+	instr = FetchInstruction();
+	if (instr != NULL) {		// NULL => exception already raised
+	    if ((OneInstruction(instr) || (instr->opCode == OP_SYSCALL))
+		    && (profile != NULL))
+		profile->Count(pc, 1);	// (see RunBlocks)
+	}
 	interrupt->OneTick();
 	if (singleStep && (runUntilTime <= stats->totalTicks))
 	  Debugger();
     }
 }
 
+//----------------------------------------------------------------------
+// BlockLength
+// 	Return the number of instructions in the basic block starting
+//	at "code", which has at most "maxLength" instructions left before
+//	the end of its page.  Set "*branch" to the index of the branch or
+//	jump that ends the block (which is the last instruction, if its
+//	delay slot is in the next page), or to -1 if it doesn't end with
+//	one.
+//----------------------------------------------------------------------
+
+static int
+BlockLength(Instruction *code, int maxLength, int *branch)
+{
+    int i;
+
+    *branch = -1;
+    for (i = 0; i < maxLength; i++) {
+	switch (code[i].opCode) {
+	  case OP_BEQ: case OP_BGEZ: case OP_BGEZAL: case OP_BGTZ:
+	  case OP_BLEZ: case OP_BLTZ: case OP_BLTZAL: case OP_BNE:
+	  case OP_J: case OP_JAL: case OP_JALR: case OP_JR:
+	    *branch = i;
+	    return min(i + 2, maxLength);	// include the delay slot
+	    
+	  case OP_SYSCALL: case OP_RES: case OP_UNIMP:
+	    return i + 1;			// always traps
+	}
+    }
+    return maxLength;
+}
+
+//----------------------------------------------------------------------
+// Machine::FindBlock
+// 	Translate the PC and return the basic block that starts there,
+//	decoding the page and finding the end of the block if this is
+//	the first time we have been here.
+//
+//	Returns NULL if the translation failed, in which case the
+//	exception has already been raised.
+//----------------------------------------------------------------------
+
+TranslationBlock *
+Machine::FindBlock()
+{
+    int physAddr, physPage, index;
+    ExceptionType exception;
+    TranslationBlock *block;
+
+    exception = Translate(registers[PCReg], &physAddr, 4, FALSE);
+    if (exception != NoException) {
+	RaiseException(exception, registers[PCReg]);
+	return NULL;
+    }
+    physPage = physAddr >> PageShift;
+    if (!decodeValid[physPage])
+	DecodePage(physPage);
+    index = (physAddr & (PageSize - 1)) >> 2;
+    block = &blockCache[physPage][index];
+    if (block->length == 0) {
+	block->code = &decodeCache[physPage][index];
+	block->length = BlockLength(block->code, PageSize / 4 - index,
+					&block->branch);
+    }
+    return block;
+}
+
+//----------------------------------------------------------------------
+// Machine::RunBlocks
+// 	Run user instructions a basic block at a time, until the next 
+//	pending interrupt is due, or the program traps to the kernel.
+//	Simulated time is charged once per block, rather than once per
+//	instruction; since we never run past the point where the next
+//	interrupt is due, every interrupt still fires after exactly the
+//	same instruction as it would with one OneTick per instruction.
+//
+//	If an instruction traps, RaiseException first charges for the
+//	instructions that ran before it in the block (ticksOwed), so the 
+//	kernel sees the same time as it would have.  The instruction 
+//	that trapped costs a tick, as always, once the kernel is done.
+//
+//	Blocks that follow each other within a page are chained.  We
+//	only follow a chain when we have not left user mode since the 
+//	last block, and are still in the same page, since then the
+//	translation of the page can't have changed underneath us.
+//
+//	If the address space is being profiled, each block is counted
+//	once, as it finishes (see profile.h).  An instruction that traps
+//	is only counted if it is a system call; any other trap either
+//	runs the instruction again, once the kernel has dealt with it,
+//	or kills the program.
+//----------------------------------------------------------------------
+
+void
+Machine::RunBlocks()
+{
+    int budget = interrupt->UserTicksUntilDue();
+    TranslationBlock *block, *prev = NULL;
+    unsigned int pageStart = 0;		// virtual address of prev's page
+    UserProfile *prof = profile;
+    int i, n, startPC;
+    bool delaySlot;
+
+    while (budget > 0) {
+	block = NULL;
+	if ((prev != NULL) && decodeValid[prev->physPage]
+		&& ((unsigned) registers[PCReg] - pageStart < (unsigned) PageSize))
+	    block = prev->Successor(registers[PCReg]);
+	if (block == NULL) {
+	    block = FindBlock();
+	    if (block == NULL) {		// instruction fetch trapped
+		interrupt->UserTicks(1);
+		return;
+	    }
+	    if ((prev != NULL) && (prev->physPage == block->physPage)
+		    && ((unsigned) registers[PCReg] - pageStart < (unsigned) PageSize)) {
+		prev->lastLinked ^= 1;		// chain prev -> block
+		prev->next[prev->lastLinked] = block;
+		prev->nextPC[prev->lastLinked] = registers[PCReg];
+	    }
+	    pageStart = (unsigned) registers[PCReg] & ~(PageSize - 1);
+	}
+
+	// If we came into the block through a delay slot (its first
+	// instruction follows a branch in another page), only that 
+	// first instruction is sure to run.
+	n = min(block->length, budget);
+	delaySlot = (registers[NextPCReg] != registers[PCReg] + 4);
+	if (delaySlot)
+	    n = 1;
+
+	// Hot blocks run compiled, as far as the compiled code can take
+	// them; the interpreter does the rest.  Either way we stop once
+	// the block has written to its own page (decodeValid is FALSE).
+	startPC = registers[PCReg];
+	i = 0;
+	if (jitEnabled && (block->compiled == NULL)
+		&& (++block->execCount >= JitThreshold))
+	    CompileBlock(block);
+	if (block->compiled != NULL)
+	    i = RunCompiled(block, n);
+	while ((i < n) && decodeValid[block->physPage]) {
+	    ticksOwed = i;
+	    if (!OneInstruction(&block->code[i])) {
+		ticksOwed = 0;		// (already charged by RaiseException)
+		if ((prof != NULL) && (block->code[i].opCode == OP_SYSCALL))
+		    prof->Count(startPC, i + 1);
+		else if (prof != NULL)
+		    prof->Count(startPC, i);
+		interrupt->UserTicks(1);	// for the one that trapped
+		return;
+	    }
+	    i++;
+	}
+	ticksOwed = 0;
+	if (prof != NULL) {
+	    prof->Count(startPC, i);
+	    if (delaySlot && (i == 1))		// finishing a branch?
+		prof->DelaySlot(registers[PCReg]);
+	    else if ((block->branch != -1) && (i > block->branch)) {
+		prof->Branch(&block->code[block->branch],
+				startPC + block->branch * 4);
+		if (i > block->branch + 1)	// (and its delay slot)
+		    prof->DelaySlot(registers[PCReg]);
+	    }
+	}
+	budget -= i;
+	interrupt->UserTicks(i);	// fires the interrupt, if now due
+	prev = block;
+    }
+}
 
 //----------------------------------------------------------------------
 // TypeToReg
@@ -67,9 +359,80 @@ TypeToReg(RegType reg, Instruction *instr)
     }
 }
 
+//----------------------------------------------------------------------
+// Machine::FetchInstruction
+// 	Translate the PC and return the decoded instruction at that
+//	address, decoding its page first if the predecode cache for
+//	the page is stale.
+//
+//	Returns NULL if the translation failed, in which case the
+//	exception has already been raised (just as ReadMem would).
+//----------------------------------------------------------------------
+
+Instruction *
+Machine::FetchInstruction()
+{
+    int physAddr;
+    ExceptionType exception;
+    int physPage;
+
+    exception = Translate(registers[PCReg], &physAddr, 4, FALSE);
+    if (exception != NoException) {
+	RaiseException(exception, registers[PCReg]);
+	return NULL;
+    }
+    physPage = physAddr >> PageShift;
+    if (!decodeValid[physPage])
+	DecodePage(physPage);
+    return &decodeCache[physPage][(physAddr & (PageSize - 1)) >> 2];
+}
+
+//----------------------------------------------------------------------
+// Machine::DecodePage
+// 	Decode every word of a physical page into the predecode cache,
+//	and forget any basic blocks previously found in the page.
+//	Data words get decoded too; that is harmless, since nobody
+//	will ever fetch them.
+//
+//	"physPage" -- the physical page number
+//----------------------------------------------------------------------
+
+void
+Machine::DecodePage(int physPage)
+{
+    Instruction *page = decodeCache[physPage];
+    TranslationBlock *blocks = blockCache[physPage];
+    unsigned int *word = (unsigned int *) &mainMemory[physPage * PageSize];
+
+    if (page == NULL) {
+	page = new Instruction[PageSize / 4];
+	decodeCache[physPage] = page;
+	blocks = new TranslationBlock[PageSize / 4];
+	blockCache[physPage] = blocks;
+	for (int i = 0; i < PageSize / 4; i++)
+	    blocks[i].compiled = NULL;
+    }
+    for (int i = 0; i < PageSize / 4; i++) {
+	page[i].value = WordToHost(word[i]);
+	page[i].Decode();
+	blocks[i].length = 0;		// blocks must be found again
+	blocks[i].physPage = physPage;
+	blocks[i].next[0] = blocks[i].next[1] = NULL;
+	blocks[i].nextPC[0] = blocks[i].nextPC[1] = -1;
+	blocks[i].lastLinked = 0;
+	blocks[i].execCount = 0;
+	if (blocks[i].compiled != NULL)
+	    delete [] blocks[i].compiled;
+	blocks[i].compiled = NULL;
+    }
+    decodeValid[physPage] = TRUE;
+}
+
 //----------------------------------------------------------------------
 // Machine::OneInstruction
-// 	Execute one instruction from a user-level program
+// 	Execute one (already fetched and decoded) instruction from a
+//	user-level program.  The dispatch on the opcode below compiles
+//	into a jump table, indexed by the predecoded opCode.
 //
 // 	If there is any kind of exception or interrupt, we invoke the 
 //	exception handler, and when it returns, we return to Run(), which
@@ -79,6 +442,9 @@ TypeToReg(RegType reg, Instruction *instr)
 // 	the OS software must increment the PC so execution begins
 // 	at the instruction immediately after the syscall. 
 //
+//	Returns FALSE if the instruction trapped to the kernel (in which
+//	case the exception handler has already run), TRUE otherwise.
+//
 //	This routine is re-entrant, in that it can be called multiple
 //	times concurrently -- one for each thread executing user code.
 //	We get re-entrancy by never caching any data -- we always re-start the
@@ -87,23 +453,18 @@ TypeToReg(RegType reg, Instruction *instr)
 //	store all data back to the machine registers and memory before
 //	leaving.  This allows the Nachos kernel to control our behavior
 //	by controlling the contents of memory, the translation table,
-//	and the register set.
+//	and the register set.  (The one exception is the predecode
+//	cache, which is keyed by physical address and dropped whenever
+//	the underlying memory is written, so it can never go stale.)
 //----------------------------------------------------------------------
 
-void
+bool
 Machine::OneInstruction(Instruction *instr)
 {
-    int raw;
     int nextLoadReg = 0; 	
     int nextLoadValue = 0; 	// record delayed load operation, to apply
 				// in the future
 
-    // Fetch instruction 
-    if (!machine->ReadMem(registers[PCReg], 4, &raw))
-	return;			// exception occurred
-    instr->value = raw;
-    instr->Decode();
-
     if (DebugIsEnabled('m')) {
        struct OpString *str = &opStrings[instr->opCode];
 
@@ -127,7 +488,7 @@ Machine::OneInstruction(Instruction *instr)
 	if (!((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
 	    ((registers[instr->rs] ^ sum) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rd] = sum;
 	break;
@@ -137,7 +498,7 @@ Machine::OneInstruction(Instruction *instr)
 	if (!((registers[instr->rs] ^ instr->extra) & SIGN_BIT) &&
 	    ((instr->extra ^ sum) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rt] = sum;
 	break;
@@ -232,7 +593,7 @@ Machine::OneInstruction(Instruction *instr)
       case OP_LBU:
 	tmp = registers[instr->rs] + instr->extra;
 	if (!machine->ReadMem(tmp, 1, &value))
-	    return;
+	    return FALSE;
 
 	if ((value & 0x80) && (instr->opCode == OP_LB))
 	    value |= 0xffffff00;
@@ -247,10 +608,10 @@ Machine::OneInstruction(Instruction *instr)
 	tmp = registers[instr->rs] + instr->extra;
 	if (tmp & 0x1) {
 	    RaiseException(AddressErrorException, tmp);
-	    return;
+	    return FALSE;
 	}
 	if (!machine->ReadMem(tmp, 2, &value))
-	    return;
+	    return FALSE;
 
 	if ((value & 0x8000) && (instr->opCode == OP_LH))
 	    value |= 0xffff0000;
@@ -269,10 +630,10 @@ Machine::OneInstruction(Instruction *instr)
 	tmp = registers[instr->rs] + instr->extra;
 	if (tmp & 0x3) {
 	    RaiseException(AddressErrorException, tmp);
-	    return;
+	    return FALSE;
 	}
 	if (!machine->ReadMem(tmp, 4, &value))
-	    return;
+	    return FALSE;
 	nextLoadReg = instr->rt;
 	nextLoadValue = value;
 	break;
@@ -286,7 +647,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);  
 
 	if (!machine->ReadMem(tmp, 4, &value))
-	    return;
+	    return FALSE;
 	if (registers[LoadReg] == instr->rt)
 	    nextLoadValue = registers[LoadValueReg];
 	else
@@ -317,7 +678,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);  
 
 	if (!machine->ReadMem(tmp, 4, &value))
-	    return;
+	    return FALSE;
 	if (registers[LoadReg] == instr->rt)
 	    nextLoadValue = registers[LoadValueReg];
 	else
@@ -373,7 +734,7 @@ Machine::OneInstruction(Instruction *instr)
 	break;
 	
       case OP_OR:
-	registers[instr->rd] = registers[instr->rs] | registers[instr->rs];
+	registers[instr->rd] = registers[instr->rs] | registers[instr->rt];
 	break;
 	
       case OP_ORI:
@@ -383,13 +744,13 @@ Machine::OneInstruction(Instruction *instr)
       case OP_SB:
 	if (!machine->WriteMem((unsigned) 
 		(registers[instr->rs] + instr->extra), 1, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 	
       case OP_SH:
 	if (!machine->WriteMem((unsigned) 
 		(registers[instr->rs] + instr->extra), 2, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 	
       case OP_SLL:
@@ -459,7 +820,7 @@ Machine::OneInstruction(Instruction *instr)
 	if (((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
 	    ((registers[instr->rs] ^ diff) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rd] = diff;
 	break;
@@ -471,7 +832,7 @@ Machine::OneInstruction(Instruction *instr)
       case OP_SW:
 	if (!machine->WriteMem((unsigned) 
 		(registers[instr->rs] + instr->extra), 4, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 	
       case OP_SWL:	  
@@ -482,7 +843,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);  
 
 	if (!machine->ReadMem((tmp & ~0x3), 4, &value))
-	    return;
+	    return FALSE;
 	switch (tmp & 0x3) {
 	  case 0:
 	    value = registers[instr->rt];
@@ -501,7 +862,7 @@ Machine::OneInstruction(Instruction *instr)
 	    break;
 	}
 	if (!machine->WriteMem((tmp & ~0x3), 4, value))
-	    return;
+	    return FALSE;
 	break;
     	
       case OP_SWR:	  
@@ -512,7 +873,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);  
 
 	if (!machine->ReadMem((tmp & ~0x3), 4, &value))
-	    return;
+	    return FALSE;
 	switch (tmp & 0x3) {
 	  case 0:
 	    value = (value & 0xffffff) | (registers[instr->rt] << 24);
@@ -528,12 +889,12 @@ Machine::OneInstruction(Instruction *instr)
 	    break;
 	}
 	if (!machine->WriteMem((tmp & ~0x3), 4, value))
-	    return;
+	    return FALSE;
 	break;
     	
       case OP_SYSCALL:
 	RaiseException(SyscallException, 0);
-	return; 
+	return FALSE; 
 	
       case OP_XOR:
 	registers[instr->rd] = registers[instr->rs] ^ registers[instr->rt];
@@ -546,7 +907,7 @@ Machine::OneInstruction(Instruction *instr)
       case OP_RES:
       case OP_UNIMP:
 	RaiseException(IllegalInstrException, 0);
-	return;
+	return FALSE;
 	
       default:
 	ASSERT(FALSE);
@@ -562,6 +923,7 @@ Machine::OneInstruction(Instruction *instr)
 						// are jumping into lala-land
     registers[PCReg] = registers[NextPCReg];
     registers[NextPCReg] = pcAfter;
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
@@ -632,7 +994,7 @@ Instruction::Decode()
 // 	double-length result of the multiplication.
 //----------------------------------------------------------------------
 
-static void
+void
 Mult(int a, int b, bool signedArith, unsigned int* hiPtr, unsigned int* loPtr)
 {
     if ((a == 0) || (b == 0)) {
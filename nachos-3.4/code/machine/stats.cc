@@ -10,6 +10,7 @@
 #include "copyright.h"
 #include "utility.h"
 #include "stats.h"
+#include "disk.h"
 
 //----------------------------------------------------------------------
 // Statistics::Statistics
@@ -22,6 +23,25 @@ Statistics::Statistics()
     numDiskReads = numDiskWrites = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
     numPageFaults = numPacketsSent = numPacketsRecvd = 0;
+    numPageOuts = numSuspensions = 0;
+    numPageOutWakeups = numPageOutFrees = numPageOutWrites = 0;
+    numFaultEvictions = numFaultWaitTicks = 0;
+    numReadAheadPages = numReadAheadHits = numReadAheadMisses = 0;
+    numMergeScans = numMergedFrames = 0;
+    numPoolStores = numPoolBytes = numPoolRejects = 0;
+    numPoolHits = numPoolSpills = 0;
+    numSwapDiskIOs = 0;
+    numCOWFaults = numCOWCopies = 0;
+    numTextShared = numZeroMapped = 0;
+    numFramesZeroed = numZeroPoolHits = numZeroPoolMisses = 0;
+    numImageLoads = numImageHits = 0;
+    for (int i = 0; i < FrameAllocBuckets; i++)
+	numFrameAllocs[i] = 0;
+    pageSize = numPhysPages = 0;
+    numTLBHits = numTLBMisses = 0;
+    numTLBSwitchedOut = numTLBSurvived = 0;
+    numCPUs = 1;
+    numCPUSwitches = 0;
 }
 
 //----------------------------------------------------------------------
@@ -38,7 +58,72 @@ Statistics::Print()
     printf("Disk I/O: reads %d, writes %d\n", numDiskReads, numDiskWrites);
     printf("Console I/O: reads %d, writes %d\n", numConsoleCharsRead, 
 	numConsoleCharsWritten);
-    printf("Paging: faults %d\n", numPageFaults);
+    printf("Paging: faults %d, page-outs %d\n", numPageFaults, numPageOuts);
+    if (numPageOutWakeups + numFaultEvictions > 0)
+	printf("Page-out daemon: woken %d times, freed %d frames, wrote %d "
+	    "pages; faults evicted %d pages themselves, waiting %d ticks\n",
+	    numPageOutWakeups, numPageOutFrees, numPageOutWrites,
+	    numFaultEvictions, numFaultWaitTicks);
+    if (numReadAheadPages > 0)
+	printf("Read-ahead: %d pages, %d used, %d wasted (%d%%)\n",
+	    numReadAheadPages, numReadAheadHits, numReadAheadMisses,
+	    numReadAheadHits * 100 / numReadAheadPages);
+    if (numPoolStores + numPoolRejects > 0) {
+	// what a page to or from disk would cost (the swap files are on
+	// the host, and cost no simulated time): a seek, half a turn,
+	// and a sector's worth of turning for each sector of the page
+	int diskTicks = SeekTime + RotationTime * SectorsPerTrack / 2
+	    + RotationTime * divRoundUp(pageSize, SectorSize);
+	printf("Compressed pool: %d pages stored at %d%% of their size, "
+	    "%d didn't compress; %d read back, %d moved to disk\n",
+	    numPoolStores, (numPoolStores > 0) ? numPoolBytes * 100
+	    / (numPoolStores * pageSize) : 0, numPoolRejects, numPoolHits,
+	    numPoolSpills);
+	printf("Swap disk: %d pages; about %d ticks saved by the pool\n",
+	    numSwapDiskIOs, (numPoolStores - numPoolSpills + numPoolHits) * diskTicks);
+    }
+    if (numMergeScans > 0)
+	printf("Merging: looked at %d frames, merged %d\n", numMergeScans,
+	    numMergedFrames);
+    if (numSuspensions > 0)
+	printf("Load control: %d processes suspended\n", numSuspensions);
+    int frameAllocs = 0;
+    for (int i = 0; i < FrameAllocBuckets; i++)
+	frameAllocs += numFrameAllocs[i];
+    if (frameAllocs > 0) {
+	printf("Frame allocations: %d; by blocks split:", frameAllocs);
+	for (int i = 0; i < FrameAllocBuckets; i++)
+	    printf(" %d%s:%d", i, (i == FrameAllocBuckets - 1) ? "+" : "",
+		numFrameAllocs[i]);
+	printf("\n");
+    }
+    if (numImageLoads + numImageHits > 0)
+	printf("Program images: %d read in, %d found cached\n",
+	    numImageLoads, numImageHits);
+    if (numZeroMapped > 0)
+	printf("Zero pages: %d faults mapped the frame of zeroes\n",
+	    numZeroMapped);
+    if (numZeroPoolHits + numZeroPoolMisses > 0)
+	printf("Zeroed frames: %d zeroed when idle; %d of %d wanted "
+	    "(%d%%) were ready\n", numFramesZeroed, numZeroPoolHits,
+	    numZeroPoolHits + numZeroPoolMisses, numZeroPoolHits * 100
+	    / (numZeroPoolHits + numZeroPoolMisses));
+    if (numTextShared > 0)
+	printf("Shared code: %d faults found the page in memory\n",
+	    numTextShared);
+    if (numCOWFaults > 0)
+	printf("Copy-on-write: faults %d, copies %d\n", numCOWFaults,
+	    numCOWCopies);
+    if (numTLBHits + numTLBMisses > 0)
+	printf("TLB: hits %d, misses %d\n", numTLBHits, numTLBMisses);
+    if (numTLBSwitchedOut > 0)
+	printf("TLB: %d of %d entries (%d%%) survived context switches\n",
+	    numTLBSurvived, numTLBSwitchedOut,
+	    (int) (100LL * numTLBSurvived / numTLBSwitchedOut));
+    if (pageSize > 0)
+	printf("Memory: %d pages of %d bytes\n", numPhysPages, pageSize);
+    if (numCPUs > 1)
+	printf("CPUs: %d, taking turns %d times\n", numCPUs, numCPUSwitches);
     printf("Network I/O: packets received %d, sent %d\n", numPacketsRecvd, 
 	numPacketsSent);
 }
@@ -13,6 +13,8 @@
 
 #include "copyright.h"
 
+#define FrameAllocBuckets 6	// size of the frame allocation histogram
+
 // The following class defines the statistics that are to be kept
 // about Nachos behavior -- how much time (ticks) elapsed, how
 // many user instructions executed, etc.
@@ -33,8 +35,53 @@ class Statistics {
     int numConsoleCharsRead;	// number of characters read from the keyboard
     int numConsoleCharsWritten; // number of characters written to the display
     int numPageFaults;		// number of virtual memory page faults
+    int numPageOuts;		// number of dirty pages written to swap
+    int numReadAheadPages;	// pages loaded before they were faulted on
+    int numReadAheadHits;	// ... that were then used
+    int numReadAheadMisses;	// ... or evicted or thrown away unused
+    int numSuspensions;		// processes swapped out by load control
+    int numPageOutWakeups;	// times the page-out daemon was woken
+    int numPageOutFrees;	// frames it freed
+    int numPageOutWrites;	// dirty pages it wrote to swap doing so
+    int numFaultEvictions;	// page faults that found no free frame,
+    int numFaultWaitTicks;	// and had to evict a page themselves
+    int numPoolStores;		// pages compressed into the pool
+    int numPoolBytes;		// ... and the bytes they took there
+    int numPoolRejects;		// pages that didn't compress well enough
+    int numPoolHits;		// pages read back from the pool
+    int numPoolSpills;		// pages moved from the pool to disk
+    int numSwapDiskIOs;		// pages read from or written to swap
+				// files on disk
+    int numMergeScans;		// frames looked at for merging
+    int numMergedFrames;	// frames freed by merging them with
+				// another with the same contents
+    int numCOWFaults;		// writes to pages shared since a Fork
+    int numCOWCopies;		// of those, how many needed a copy
+    int numImageLoads;		// programs read in from their files
+    int numImageHits;		// programs run again without reading them
+    int numFrameAllocs[FrameAllocBuckets];
+				// frame allocations, by how many blocks
+				// had to be split to make them (the last
+				// counts that many or more)
+    int numFramesZeroed;	// by the idle loop, ahead of time
+    int numZeroPoolHits;	// zeroed frames asked for and found ready
+    int numZeroPoolMisses;	// ... and zeroed on the spot
+    int numZeroMapped;		// page faults mapping the frame of zeroes
+    int numTextShared;		// page faults on code that was already
+				// in memory for another process
+    int numTLBHits;		// translations found in the TLB
+    int numTLBMisses;		// translations the kernel had to load
+    int numTLBSwitchedOut;	// TLB entries address spaces had when
+				// they were switched out
+    int numTLBSurvived;		// of those, how many were still there
+				// when they were switched back in
     int numPacketsSent;		// number of packets sent over the network
     int numPacketsRecvd;	// number of packets received over the network
+    int numCPUs;		// simulated processors (-cpus)
+    int numCPUSwitches;		// times one handed the host to another
+
+    int pageSize;		// size of a page, and # of pages of
+    int numPhysPages;		// physical memory (0 if no user programs)
 
     Statistics(); 		// initialize everything to zero
 
@@ -36,6 +36,7 @@ extern "C" {
 #include <sys/file.h>
 #include <sys/un.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #ifdef HOST_i386
 #include <unistd.h>
 #include <sys/time.h>
@@ -267,6 +268,47 @@ Unlink(const char *name)
     return unlink(name);
 }
 
+//----------------------------------------------------------------------
+// FileId
+// 	Return a number that identifies the file open on "fd": the same
+//	for every descriptor open on that file, whatever name it was
+//	opened by.  (Its inode number.)
+//----------------------------------------------------------------------
+
+int
+FileId(int fd)
+{
+    struct stat buf;
+
+    if (fstat(fd, &buf) < 0)
+	return -1;
+    return (int) buf.st_ino;
+}
+
+//----------------------------------------------------------------------
+// FileVersion
+// 	Return a number that changes whenever the file open on "fd" is
+//	written to: a hash of its modification and status change times,
+//	to the nanosecond, since a file can be rewritten more than once a
+//	second.  (The status change time also changes when a new file gets
+//	the inode number of one that was removed.)
+//----------------------------------------------------------------------
+
+int
+FileVersion(int fd)
+{
+    struct stat buf;
+    unsigned int hash;
+
+    if (fstat(fd, &buf) < 0)
+	return -1;
+    hash = (unsigned int) buf.st_mtim.tv_sec;
+    hash = hash * 1000003 + (unsigned int) buf.st_mtim.tv_nsec;
+    hash = hash * 1000003 + (unsigned int) buf.st_ctim.tv_sec;
+    hash = hash * 1000003 + (unsigned int) buf.st_ctim.tv_nsec;
+    return (int) hash;
+}
+
 //----------------------------------------------------------------------
 // OpenSocket
 // 	Open an interprocess communication (IPC) connection.  For now, 
@@ -28,6 +28,8 @@ extern void Lseek(int fd, int offset, int whence);
 extern int Tell(int fd);
 extern void Close(int fd);
 extern bool Unlink(const char *name);
+extern int FileId(int fd);
+extern int FileVersion(int fd);
 
 // Interprocess communication operations, for simulating the network
 extern int OpenSocket();
@@ -59,6 +61,7 @@ extern void DeallocBoundedArray(char *p, int size);
 // These are assumed to be portable, so we don't include a wrapper.
 extern "C" {
     int atoi(const char *str) throw();
+    long strtol(const char *str, char **end, int base) throw();
     double atof(const char *str) throw();
     int abs(int i) throw();
     
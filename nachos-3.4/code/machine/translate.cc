@@ -22,6 +22,9 @@
 //
 //	Note that the contents of the TLB are specific to an address space.
 //	If the address space changes, so does the contents of the TLB!
+//	(Unless, as here, each TLB entry is tagged with the identifier
+//	of its address space, and only matches while that address
+//	space is running.)
 //
 // DO NOT CHANGE -- part of the machine emulation
 //
@@ -34,50 +37,35 @@
 #include "addrspace.h"
 #include "system.h"
 
-// Routines for converting Words and Short Words to and from the
-// simulated machine's format of little endian.  These end up
-// being NOPs when the host machine is also little endian (DEC and Intel).
-
-unsigned int
-WordToHost(unsigned int word) {
-#ifdef HOST_IS_BIG_ENDIAN
-	 register unsigned long result;
-	 result = (word >> 24) & 0x000000ff;
-	 result |= (word >> 8) & 0x0000ff00;
-	 result |= (word << 8) & 0x00ff0000;
-	 result |= (word << 24) & 0xff000000;
-	 return result;
-#else 
-	 return word;
-#endif /* HOST_IS_BIG_ENDIAN */
-}
+//----------------------------------------------------------------------
+// ReadHost
+//      Return the 1, 2, or 4 byte value stored in simulated memory at
+//	"host", sign-extending a byte as the hardware would.
+//----------------------------------------------------------------------
 
-unsigned short
-ShortToHost(unsigned short shortword) {
-#ifdef HOST_IS_BIG_ENDIAN
-	 register unsigned short result;
-	 result = (shortword << 8) & 0xff00;
-	 result |= (shortword >> 8) & 0x00ff;
-	 return result;
-#else 
-	 return shortword;
-#endif /* HOST_IS_BIG_ENDIAN */
+static inline int
+ReadHost(char *host, int size)
+{
+    switch (size) {
+      case 1:
+	return *host;
+      case 2:
+	return ShortToHost(*(unsigned short *) host);
+      case 4:
+	return WordToHost(*(unsigned int *) host);
+      default: 
+	ASSERT(FALSE);
+	return 0;
+    }
 }
 
-unsigned int
-WordToMachine(unsigned int word) { return WordToHost(word); }
-
-unsigned short
-ShortToMachine(unsigned short shortword) { return ShortToHost(shortword); }
-
-
 //----------------------------------------------------------------------
 // Machine::ReadMem
 //      Read "size" (1, 2, or 4) bytes of virtual memory at "addr" into 
 //	the location pointed to by "value".
 //
 //   	Returns FALSE if the translation step from virtual to physical memory
-//   	failed.
+//   	failed.  Pages in the soft TLB don't need translating at all.
 //
 //	"addr" -- the virtual address to read from
 //	"size" -- the number of bytes to read (1, 2, or 4)
@@ -87,10 +75,14 @@ ShortToMachine(unsigned short shortword) { return ShortToHost(shortword); }
 bool
 Machine::ReadMem(int addr, int size, int *value)
 {
-    int data;
     ExceptionType exception;
     int physicalAddress;
+    char *host = HostAddress(addr, size, FALSE);
     
+    if (host != NULL) {			// in the soft TLB
+	*value = ReadHost(host, size);
+	return TRUE;
+    }
     DEBUG('a', "Reading VA 0x%x, size %d\n", addr, size);
     
     exception = Translate(addr, &physicalAddress, size, FALSE);
@@ -98,24 +90,7 @@ Machine::ReadMem(int addr, int size, int *value)
 	machine->RaiseException(exception, addr);
 	return FALSE;
     }
-    switch (size) {
-      case 1:
-	data = machine->mainMemory[physicalAddress];
-	*value = data;
-	break;
-	
-      case 2:
-	data = *(unsigned short *) &machine->mainMemory[physicalAddress];
-	*value = ShortToHost(data);
-	break;
-	
-      case 4:
-	data = *(unsigned int *) &machine->mainMemory[physicalAddress];
-	*value = WordToHost(data);
-	break;
-
-      default: ASSERT(FALSE);
-    }
+    *value = ReadHost(&mainMemory[physicalAddress], size);
     
     DEBUG('a', "\tvalue read = %8.8x\n", *value);
     return (TRUE);
@@ -139,27 +114,31 @@ Machine::WriteMem(int addr, int size, int value)
 {
     ExceptionType exception;
     int physicalAddress;
+    char *host = HostAddress(addr, size, TRUE);
      
-    DEBUG('a', "Writing VA 0x%x, size %d, value 0x%x\n", addr, size, value);
-
-    exception = Translate(addr, &physicalAddress, size, TRUE);
-    if (exception != NoException) {
-	machine->RaiseException(exception, addr);
-	return FALSE;
+    if (host == NULL) {			// not in the soft TLB
+	DEBUG('a', "Writing VA 0x%x, size %d, value 0x%x\n", addr, size,
+			value);
+	exception = Translate(addr, &physicalAddress, size, TRUE);
+	if (exception != NoException) {
+	    machine->RaiseException(exception, addr);
+	    return FALSE;
+	}
+	host = &mainMemory[physicalAddress];
     }
+    if (decodeValid[(host - mainMemory) >> PageShift])	// writing to code?
+	InvalidateDecodeCache((host - mainMemory) >> PageShift);
     switch (size) {
       case 1:
-	machine->mainMemory[physicalAddress] = (unsigned char) (value & 0xff);
+	*host = (unsigned char) (value & 0xff);
 	break;
 
       case 2:
-	*(unsigned short *) &machine->mainMemory[physicalAddress]
-		= ShortToMachine((unsigned short) (value & 0xffff));
+	*(unsigned short *) host = ShortToMachine((unsigned short) (value & 0xffff));
 	break;
       
       case 4:
-	*(unsigned int *) &machine->mainMemory[physicalAddress]
-		= WordToMachine((unsigned int) value);
+	*(unsigned int *) host = WordToMachine((unsigned int) value);
 	break;
 	
       default: ASSERT(FALSE);
@@ -177,6 +156,9 @@ Machine::WriteMem(int addr, int size, int value)
 //	address in "physAddr".  If there was an error, returns the type
 //	of the exception.
 //
+//	On success, the page also goes into the soft TLB (see machine.h),
+//	unless we are tracing address translation with "-d a".
+//
 //	"virtAddr" -- the virtual address to translate
 //	"physAddr" -- the place to store the physical address
 //	"size" -- the amount of memory being read or written
@@ -205,8 +187,8 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 
 // calculate the virtual page number, and offset within the page,
 // from the virtual address
-    vpn = (unsigned) virtAddr / PageSize;
-    offset = (unsigned) virtAddr % PageSize;
+    vpn = (unsigned) virtAddr >> PageShift;
+    offset = (unsigned) virtAddr & (PageSize - 1);
     
     if (tlb == NULL) {		// => page table => vpn is index into table
 	if (vpn >= pageTableSize) {
@@ -220,9 +202,12 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 	}
 	entry = &pageTable[vpn];
     } else {
-        for (entry = NULL, i = 0; i < TLBSize; i++)
-    	    if (tlb[i].valid && (tlb[i].virtualPage == vpn)) {
-		entry = &tlb[i];			// FOUND!
+	TranslationEntry *set = TLBSet(vpn);	// only look where it
+						// could be
+        for (entry = NULL, i = 0; i < TLBWays; i++)
+    	    if (set[i].valid && (set[i].virtualPage == vpn)
+						&& (set[i].asid == asid)) {
+		entry = &set[i];			// FOUND!
 		break;
 	    }
 	if (entry == NULL) {				// not found
@@ -231,6 +216,7 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 						// the page may be in memory,
 						// but not in the TLB
 	}
+	tlbHits++;
     }
 
     if (entry->readOnly && writing) {	// trying to write to a read-only page
@@ -241,14 +227,24 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 
     // if the pageFrame is too big, there is something really wrong! 
     // An invalid translation was loaded into the page table or TLB. 
-    if (pageFrame >= NumPhysPages) { 
+    if (pageFrame >= (unsigned) NumPhysPages) { 
 	DEBUG('a', "*** frame %d > %d!\n", pageFrame, NumPhysPages);
 	return BusErrorException;
     }
     entry->use = TRUE;		// set the use, dirty bits
     if (writing)
 	entry->dirty = TRUE;
-    *physAddr = pageFrame * PageSize + offset;
+    *physAddr = (pageFrame << PageShift) + offset;
+    if (!DebugIsEnabled('a')) {
+	SoftTLBEntry *e = &softTLB[vpn & (SoftTLBSize - 1)];
+
+	e->readTag = vpn << PageShift;
+	if (entry->dirty && !entry->readOnly)
+	    e->writeTag = vpn << PageShift;
+	else
+	    e->writeTag = (unsigned) -1;
+	e->page = &mainMemory[pageFrame << PageShift];
+    }
     ASSERT((*physAddr >= 0) && ((*physAddr + size) <= MemorySize));
     DEBUG('a', "phys addr = 0x%x\n", *physAddr);
     return NoException;
@@ -40,6 +40,10 @@ class TranslationEntry {
 			// page is referenced or modified.
     bool dirty;         // This bit is set by the hardware every time the
 			// page is modified.
+    int asid;		// In a TLB entry: the address space the mapping
+			// belongs to; it only matches while the machine's
+			// "asid" register holds the same value.  Unused
+			// in page tables.
 };
 
 #endif
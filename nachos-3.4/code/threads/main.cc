@@ -8,8 +8,12 @@
 //
 // 	Most of this file is not needed until later assignments.
 //
-// Usage: nachos -d <debugflags> -rs <random seed #>
-//		-s -x <nachos file> -c <consoleIn> <consoleOut>
+// Usage: nachos -d <debugflags> -rs <random seed #> -cpus <n>
+//		-s -j -jd -P -x <nachos file> -c <consoleIn> <consoleOut>
+//		-mem <bytes> -pagesize <bytes>
+//		-checkpoint <file> <ticks> -restore <file>
+//		-tlb <entries> <ways> <policy> -merge <frames> -cpool <frames>
+//		-pageout <frames>
 //		-f -cp <unix file> <nachos file>
 //		-p <nachos file> -r <nachos file> -l -D -t
 //              -n <network reliability> -m <machine id>
@@ -18,12 +22,41 @@
 //
 //    -d causes certain debugging messages to be printed (cf. utility.h)
 //    -rs causes Yield to occur at random (but repeatable) spots
+//    -cpus sets the number of CPUs, which take turns on the host, and
+//	share the ready list (cf. scheduler.cc); the default is 1
 //    -z prints the copyright message
 //
 //  USER_PROGRAM
 //    -s causes user programs to be executed in single-step mode
+//    -j compiles frequently run user code, for speed
+//    -jd is like -j, but also checks the compiled code against the
+//	simulator, and stops at the first difference
+//    -P profiles each user program, and prints the profiles at halt
 //    -x runs a user program
 //    -c tests the console
+//    -mem sets the size of physical memory (e.g., 64K or 64M), and
+//	-pagesize the page size (a power of two); both default to
+//	those of the original machine, 32 pages of 128 bytes
+//    -checkpoint saves the user programs to a file once simulated time
+//	reaches <ticks> (and carries on)
+//    -restore starts the user programs saved by -checkpoint, instead
+//	of starting a program from scratch with -x; neither works with
+//	the Nachos file system (FILESYS)
+//
+//  VM
+//    -tlb sets the size of the TLB, the # of entries in each set, and
+//	how to choose an entry to replace: random, fifo, or clock (an
+//	approximation of LRU).  The default is 4 entries, fully
+//	associative, random.
+//    -merge sets how many frames to look at, at each context switch,
+//	for frames with the same contents to merge (0 to never merge).
+//	The default is 8.
+//    -cpool sets how many frames to set aside for keeping swapped-out
+//	pages compressed in memory, instead of on disk (0 for none).
+//	The default is an eighth of memory.
+//    -pageout sets how many frames the page-out daemon keeps free, so
+//	that page faults needn't evict pages themselves (0 for no daemon).
+//	The default is a sixteenth of memory, and at least one frame.
 //
 //  FILESYS
 //    -f causes the physical disk to be formatted
@@ -63,6 +96,7 @@ extern int testnum;
 extern void ThreadTest(void), Copy(char *unixFile, char *nachosFile);
 extern void Print(char *file), PerformanceTest(void);
 extern void StartProcess(char *file), ConsoleTest(char *in, char *out);
+extern void RestoreCheckpoint(const char *file);
 extern void MailTest(int networkID);
 
 //----------------------------------------------------------------------
@@ -114,6 +148,10 @@ main(int argc, char **argv)
 	    ASSERT(argc > 1);
             StartProcess(*(argv + 1));
             argCount = 2;
+        } else if (!strcmp(*argv, "-restore")) {	// resume user programs
+	    ASSERT(argc > 1);
+            RestoreCheckpoint(*(argv + 1));
+            argCount = 2;
         } else if (!strcmp(*argv, "-c")) {      // test the console
 	    if (argc == 1)
 	        ConsoleTest(NULL, NULL);
@@ -14,6 +14,21 @@
 // 	Very simple implementation -- no priorities, straight FIFO.
 //	Might need to be improved in later assignments.
 //
+//	With "-cpus", the machine has several CPUs, sharing one ready
+//	list.  They are simulated on the one host thread, deterministically:
+//	each CPU in turn runs for CPUQuantum ticks of simulated time, and
+//	then the next CPU with anything to do gets the host.  A CPU whose
+//	turn ends keeps its thread and registers to itself (class CPU);
+//	a CPU with no thread takes the next one off the ready list, and
+//	when a CPU's thread blocks with nothing else ready, that CPU sits
+//	idle, and the turn goes to the next CPU that has work.
+//
+//	Since only one CPU runs at a time, and turns only change in
+//	interrupt handlers, disabling interrupts still keeps every other
+//	CPU out too; synchronization needs no changes.  The CPUs share
+//	one simulated clock, which each advances in its turn; we only
+//	keep track of how much of it each CPU had.
+//
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
@@ -24,12 +39,24 @@
 
 //----------------------------------------------------------------------
 // Scheduler::Scheduler
-// 	Initialize the list of ready but not running threads to empty.
+// 	Initialize the list of ready but not running threads to empty,
+//	and "processors" CPUs with nothing to run; CPU 0 has the first turn.
 //----------------------------------------------------------------------
 
-Scheduler::Scheduler()
+Scheduler::Scheduler(int processors)
 { 
     readyList = new List; 
+    numCPUs = processors;
+    cpus = new CPU[numCPUs];
+    for (int i = 0; i < numCPUs; i++) {
+	cpus[i].id = i;
+	cpus[i].thread = NULL;
+	cpus[i].saved = FALSE;
+	cpus[i].ticks = 0;
+    }
+    current = &cpus[0];
+    quantumPending = FALSE;
+    turnStart = 0;
 } 
 
 //----------------------------------------------------------------------
@@ -40,6 +67,7 @@ Scheduler::Scheduler()
 Scheduler::~Scheduler()
 { 
     delete readyList; 
+    delete [] cpus;
 } 
 
 //----------------------------------------------------------------------
@@ -57,6 +85,7 @@ Scheduler::ReadyToRun (Thread *thread)
 
     thread->setStatus(READY);
     readyList->Append((void *)thread);
+    ScheduleQuantum();			// (an idle CPU could run it)
 }
 
 //----------------------------------------------------------------------
@@ -99,11 +128,24 @@ Scheduler::Run (Thread *nextThread)
     }
 #endif
     
+    nextThread->setStatus(RUNNING);      // nextThread is now running
+    Switch(oldThread, nextThread);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Switch
+// 	Switch the host from "oldThread" to "nextThread", whose state
+//	(other than its host stack) the caller has set up, or saved in
+//	its CPU.  Returns when some CPU switches back to "oldThread".
+//----------------------------------------------------------------------
+
+void
+Scheduler::Switch (Thread *oldThread, Thread *nextThread)
+{
     oldThread->CheckOverflow();		    // check if the old thread
 					    // had an undetected stack overflow
 
     currentThread = nextThread;		    // switch to the next thread
-    currentThread->setStatus(RUNNING);      // nextThread is now running
     
     DEBUG('t', "Switching from thread \"%s\" to thread \"%s\"\n",
 	  oldThread->getName(), nextThread->getName());
@@ -126,12 +168,220 @@ Scheduler::Run (Thread *nextThread)
 	threadToBeDestroyed = NULL;
     }
     
+    if (current->saved)			// our CPU's turn has come round
+	current->Restore();		// again
 #ifdef USER_PROGRAM
-    if (currentThread->space != NULL) {		// if there is an address space
+    else if (currentThread->space != NULL) {	// if there is an address space
         currentThread->RestoreUserState();     // to restore, do it.
 	currentThread->space->RestoreState();
     }
 #endif
+    ScheduleQuantum();
+}
+
+//----------------------------------------------------------------------
+// Scheduler::SwitchCPU
+// 	The current CPU's turn is over (see QuantumExpired): give the
+//	host to the next CPU, in order, that has a thread, or that can
+//	take one off the ready list.  The current CPU keeps its thread,
+//	which carries on where it left off at the CPU's next turn.  If no
+//	other CPU can run anything, the current one carries on.
+//----------------------------------------------------------------------
+
+void
+Scheduler::SwitchCPU()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    CPU *from = current, *to = NULL;
+    Thread *oldThread = currentThread;
+    int i;
+
+    for (i = 1; (i < numCPUs) && (to == NULL); i++) {
+	to = &cpus[(from->id + i) % numCPUs];
+	if (to->thread == NULL) {
+	    to->thread = FindNextToRun();
+	    if (to->thread == NULL)
+		to = NULL;
+	    else
+		to->thread->setStatus(RUNNING);
+	}
+    }
+    EndTurn();
+    if (to != NULL) {
+	DEBUG('t', "CPU %d's turn is over; CPU %d's turn\n", from->id,
+		to->id);
+	from->thread = oldThread;
+	from->Save();
+	current = to;
+	stats->numCPUSwitches++;
+	Switch(oldThread, to->thread);
+    } else
+	ScheduleQuantum();
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::LeaveCPU
+// 	Called when the current thread blocks, and nothing is ready to
+//	run: the current CPU goes idle, and the host goes to the next
+//	CPU that is in the middle of running something.
+//
+//	Returns FALSE straight away if there is no such CPU.  Otherwise,
+//	returns once the blocked thread has been woken up and is running
+//	again -- on whichever CPU took it off the ready list.
+//----------------------------------------------------------------------
+
+bool
+Scheduler::LeaveCPU()
+{
+    Thread *oldThread = currentThread;
+    CPU *to = NULL;
+    int i;
+
+    ASSERT(interrupt->getLevel() == IntOff);
+    for (i = 1; (i < numCPUs) && (to == NULL); i++) {
+	to = &cpus[(current->id + i) % numCPUs];
+	if (to->thread == NULL)
+	    to = NULL;
+    }
+    if (to == NULL)
+	return FALSE;
+    EndTurn();
+    DEBUG('t', "CPU %d is idle; CPU %d's turn\n", current->id, to->id);
+#ifdef USER_PROGRAM
+    if (oldThread->space != NULL) {	// it may run on another CPU next
+        oldThread->SaveUserState();
+	oldThread->space->SaveState();
+    }
+#endif
+    current->thread = NULL;
+    current = to;
+    stats->numCPUSwitches++;
+    Switch(oldThread, to->thread);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// QuantumInterruptHandler
+// 	Interrupt handler for the end of a CPU's turn.
+//----------------------------------------------------------------------
+
+static void
+QuantumInterruptHandler(int dummy)
+{
+    scheduler->QuantumExpired();
+}
+
+//----------------------------------------------------------------------
+// Scheduler::QuantumExpired
+// 	The current CPU has had its turn.  As with a time slice, we
+//	can't switch inside the interrupt handler, so we have the switch
+//	done once the handler returns.  If the machine is idle, though,
+//	no CPU has anything to run.
+//----------------------------------------------------------------------
+
+void
+Scheduler::QuantumExpired()
+{
+    quantumPending = FALSE;
+    if (interrupt->getStatus() != IdleMode)
+	interrupt->SwitchCPUOnReturn();
+}
+
+//----------------------------------------------------------------------
+// Scheduler::ScheduleQuantum
+// 	Arrange for the current CPU's turn to end in CPUQuantum ticks,
+//	unless that is already arranged, or no other CPU has anything it
+//	could run.  (If we kept the interrupt pending regardless, Nachos
+//	would never find itself idle, and halt.)
+//----------------------------------------------------------------------
+
+void
+Scheduler::ScheduleQuantum()
+{
+    bool work = FALSE, idle = FALSE;
+
+    if ((numCPUs == 1) || quantumPending)
+	return;
+    for (int i = 0; i < numCPUs; i++)
+	if (&cpus[i] != current) {
+	    if (cpus[i].thread != NULL)
+		work = TRUE;
+	    else
+		idle = TRUE;
+	}
+    if (work || (idle && !readyList->IsEmpty())) {
+	quantumPending = TRUE;
+	interrupt->Schedule(QuantumInterruptHandler, 0, CPUQuantum, TimerInt);
+    }
+}
+
+//----------------------------------------------------------------------
+// Scheduler::EndTurn
+// 	The current CPU's turn is over (or, at halt, is being counted):
+//	charge the simulated time since it began to the CPU.
+//----------------------------------------------------------------------
+
+void
+Scheduler::EndTurn()
+{
+    current->ticks += stats->totalTicks - turnStart;
+    turnStart = stats->totalTicks;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Account
+// 	Nachos is halting: count the turn in progress, and print how much
+//	of the time each CPU had the host.
+//----------------------------------------------------------------------
+
+void
+Scheduler::Account()
+{
+    if (numCPUs == 1)
+	return;
+    EndTurn();
+    for (int i = 0; i < numCPUs; i++)
+	printf("CPU %d: %d ticks\n", i, cpus[i].ticks);
+}
+
+//----------------------------------------------------------------------
+// CPU::Save
+// 	The CPU's turn is over, in the middle of running "thread": keep
+//	its registers, and let its address space save what it needs to.
+//----------------------------------------------------------------------
+
+void
+CPU::Save()
+{
+#ifdef USER_PROGRAM
+    if (thread->space != NULL) {
+	for (int i = 0; i < NumTotalRegs; i++)
+	    registers[i] = machine->ReadRegister(i);
+	thread->space->SaveState();
+    }
+#endif
+    saved = TRUE;
+}
+
+//----------------------------------------------------------------------
+// CPU::Restore
+// 	The CPU's turn has come round again: put back the registers of
+//	its thread, and its address space's page table (or TLB).
+//----------------------------------------------------------------------
+
+void
+CPU::Restore()
+{
+    saved = FALSE;
+#ifdef USER_PROGRAM
+    if (thread->space != NULL) {
+	for (int i = 0; i < NumTotalRegs; i++)
+	    machine->WriteRegister(i, registers[i]);
+	thread->space->RestoreState();
+    }
+#endif
+    thread = NULL;			// (it is currentThread now)
 }
 
 //----------------------------------------------------------------------
@@ -13,13 +13,38 @@
 #include "list.h"
 #include "thread.h"
 
+#define CPUQuantum	100	// ticks each CPU runs, with -cpus, before
+				// the next one gets a turn
+
+// One simulated processor.  With "-cpus", there are several of them;
+// they share main memory, the devices, simulated time and the ready
+// list, and take turns on the host (see scheduler.cc).  The one whose
+// turn it is owns "currentThread" and the machine's registers; each of
+// the others keeps its own here, until its next turn.
+
+class CPU {
+  public:
+    int id;
+    Thread *thread;		// what it was running when its turn
+				// ended; NULL if it had nothing to run
+    bool saved;			// is its state saved here?
+#ifdef USER_PROGRAM
+    int registers[NumTotalRegs];	// the user registers of "thread"
+#endif
+    int ticks;			// simulated time it has had the host
+
+    void Save();		// Keep the running thread's state here
+    void Restore();		// ... and put it back
+};
+
 // The following class defines the scheduler/dispatcher abstraction -- 
 // the data structures and operations needed to keep track of which 
 // thread is running, and which threads are ready but not running.
 
 class Scheduler {
   public:
-    Scheduler();			// Initialize list of ready threads 
+    Scheduler(int processors);		// Initialize list of ready threads,
+					// for "processors" CPUs
     ~Scheduler();			// De-allocate ready list
 
     void ReadyToRun(Thread* thread);	// Thread can be dispatched.
@@ -27,10 +52,30 @@ class Scheduler {
 					// list, if any, and return thread.
     void Run(Thread* nextThread);	// Cause nextThread to start running
     void Print();			// Print contents of ready list
+
+    void SwitchCPU();			// Give the next CPU a turn
+    bool LeaveCPU();			// The current thread is blocked; give
+					// the turn to a CPU with work, if any
+    void QuantumExpired();		// Time for the next CPU's turn
+    void Account();			// Count the turn in progress, and
+					// print how busy each CPU was
+    int NumCPUs() { return numCPUs; }
     
   private:
     List *readyList;  		// queue of threads that are ready to run,
 				// but not running
+    CPU *cpus;			// the processors
+    int numCPUs;
+    CPU *current;		// the one whose turn it is
+    bool quantumPending;	// is QuantumExpired scheduled?
+    int turnStart;		// when the current turn began
+
+    void Switch(Thread *oldThread, Thread *nextThread);
+					// Switch host stacks, and restore
+					// the state of whoever we switch to
+    void EndTurn();			// The current CPU's turn is over
+    void ScheduleQuantum();		// Arrange for the next turn, if
+					// any other CPU has work
 };
 
 #endif // SCHEDULER_H
@@ -7,7 +7,21 @@
 
 #include "copyright.h"
 #include "system.h"
+#include <errno.h>
+#include <limits.h>
 #include "../userprog/memorymanager.h"
+#include "../userprog/profile.h"
+#include "../userprog/checkpoint.h"
+#ifdef USE_TLB
+#include "../vm/tlb.h"
+#endif
+#ifdef VM
+#include "../vm/frametable.h"
+#include "../vm/loadcontrol.h"
+#include "../vm/merge.h"
+#include "../vm/compress.h"
+#include "../vm/pageout.h"
+#endif
 
 
 
@@ -21,6 +35,7 @@ Interrupt *interrupt;			// interrupt status
 Statistics *stats;			// performance metrics
 Timer *timer;				// the hardware timer device,
 					// for invoking context switches
+int numThreads = 0;			// # of Thread objects in existence
 
 
 #ifdef FILESYS_NEEDED
@@ -39,6 +54,18 @@ Lock* mmLock;
 PCBManager* pcbManager;
 #endif
 
+#ifdef USE_TLB
+TLBManager *tlbManager;		// refills the TLB
+#endif
+
+#ifdef VM
+FrameTable *frameTable;		// who has each frame, and who loses it
+LoadControl *loadControl;	// which processes may have frames at all
+PageMerger *pageMerger;		// merges frames with the same contents
+CompressedPool *compressedPool;	// swapped pages kept in memory
+PageOutDaemon *pageOutDaemon;	// keeps some frames free for faults
+#endif
+
 #ifdef NETWORK
 PostOffice *postOffice;
 #endif
@@ -72,6 +99,38 @@ TimerInterruptHandler(int dummy)
 	interrupt->YieldOnReturn();
 }
 
+#ifdef USER_PROGRAM
+//----------------------------------------------------------------------
+// ParseSize
+// 	Convert a size given on the command line, such as "4096", "64K"
+//	or "64M", to bytes.  Anything else, or a size that doesn't fit in
+//	an int (as MemorySize must), gets a usage message.
+//----------------------------------------------------------------------
+static int
+ParseSize(char *arg)
+{
+    char *end;
+    long size, unit = 1;
+
+    errno = 0;
+    size = strtol(arg, &end, 10);
+    if ((*end == 'k') || (*end == 'K')) {
+	unit = 1024;
+	end++;
+    } else if ((*end == 'm') || (*end == 'M')) {
+	unit = 1024 * 1024;
+	end++;
+    }
+    if ((end == arg) || (*end != '\0') || (errno == ERANGE) || (size <= 0)
+	    || (size > INT_MAX / unit)) {
+	printf("Bad size \"%s\": give a number of bytes, or of K or M, "
+	    "below 2G\n", arg);
+	Exit(1);
+    }
+    return (int) (size * unit);
+}
+#endif
+
 //----------------------------------------------------------------------
 // Initialize
 // 	Initialize Nachos global data structures.  Interpret command
@@ -88,9 +147,27 @@ Initialize(int argc, char **argv)
     int argCount;
     const char* debugArgs = "";
     bool randomYield = FALSE;
+    int numCPUs = 1;		// simulated processors
 
 #ifdef USER_PROGRAM
     bool debugUserProg = FALSE;	// single step user program
+    bool useJIT = FALSE;	// compile hot user code
+    bool checkJIT = FALSE;	// check compiled code against the simulator
+    char *checkpointFile = NULL;	// write a checkpoint here,
+    int checkpointTime = 0;		// at this time
+    int pageSize = DefaultPageSize;	// bytes per page
+    int memorySize = DefaultNumPhysPages * DefaultPageSize;
+					// bytes of physical memory
+#endif
+#ifdef USE_TLB
+    int tlbSize = DefaultTLBSize;	// TLB entries
+    int tlbWays = DefaultTLBWays;	// entries per set
+    TLBPolicy tlbPolicy = TLBRandom;	// which entry to replace
+#endif
+#ifdef VM
+    int mergeRate = DefaultMergeRate;	// frames to look at per switch
+    int poolFrames = -1;		// frames for compressed swap
+    int pageOutTarget = -1;		// frames to keep free
 #endif
 #ifdef FILESYS_NEEDED
     bool format = FALSE;	// format disk
@@ -115,10 +192,62 @@ Initialize(int argc, char **argv)
 						// number generator
 	    randomYield = TRUE;
 	    argCount = 2;
+	} else if (!strcmp(*argv, "-cpus")) {
+	    ASSERT(argc > 1);
+	    numCPUs = atoi(*(argv + 1));
+	    ASSERT(numCPUs > 0);
+	    argCount = 2;
 	}
 #ifdef USER_PROGRAM
 	if (!strcmp(*argv, "-s"))
 	    debugUserProg = TRUE;
+	else if (!strcmp(*argv, "-j"))
+	    useJIT = TRUE;
+	else if (!strcmp(*argv, "-jd"))
+	    useJIT = checkJIT = TRUE;
+	else if (!strcmp(*argv, "-P"))
+	    profileUserPrograms = TRUE;
+	else if (!strcmp(*argv, "-mem")) {
+	    ASSERT(argc > 1);
+	    memorySize = ParseSize(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-pagesize")) {
+	    ASSERT(argc > 1);
+	    pageSize = ParseSize(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-checkpoint")) {
+	    ASSERT(argc > 2);
+	    checkpointFile = *(argv + 1);
+	    checkpointTime = atoi(*(argv + 2));
+	    argCount = 3;
+	}
+#endif
+#ifdef USE_TLB
+	if (!strcmp(*argv, "-tlb")) {
+	    ASSERT(argc > 3);
+	    tlbSize = atoi(*(argv + 1));
+	    tlbWays = atoi(*(argv + 2));
+	    if (!ParseTLBPolicy(*(argv + 3), &tlbPolicy)) {
+		printf("Usage: -tlb <entries> <ways> random|fifo|clock\n");
+		Exit(1);
+	    }
+	    argCount = 4;
+	}
+#endif
+#ifdef VM
+	if (!strcmp(*argv, "-merge")) {
+	    ASSERT(argc > 1);
+	    mergeRate = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-cpool")) {
+	    ASSERT(argc > 1);
+	    poolFrames = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-pageout")) {
+	    ASSERT(argc > 1);
+	    pageOutTarget = atoi(*(argv + 1));
+	    argCount = 2;
+	}
 #endif
 #ifdef FILESYS_NEEDED
 	if (!strcmp(*argv, "-f"))
@@ -140,7 +269,8 @@ Initialize(int argc, char **argv)
     DebugInit(debugArgs);			// initialize DEBUG messages
     stats = new Statistics();			// collect statistics
     interrupt = new Interrupt;			// start up interrupt handling
-    scheduler = new Scheduler();		// initialize the ready queue
+    scheduler = new Scheduler(numCPUs);	// initialize the ready queue
+    stats->numCPUs = numCPUs;
     if (randomYield)				// start the timer (if needed)
 	timer = new Timer(TimerInterruptHandler, 0, randomYield);
 
@@ -156,8 +286,37 @@ Initialize(int argc, char **argv)
     CallOnUserAbort(Cleanup);			// if user hits ctl-C
     
 #ifdef USER_PROGRAM
+    SetMemorySize(pageSize, memorySize);
+    stats->pageSize = PageSize;
+    stats->numPhysPages = NumPhysPages;
+#ifdef USE_TLB
+    SetTLBSize(tlbSize, tlbWays);
+#endif
     machine = new Machine(debugUserProg);	// this must come first
+    if (useJIT)
+	machine->EnableJIT(checkJIT);
     mm = new MemoryManager();
+#ifdef VM
+    frameTable = new FrameTable();
+    loadControl = new LoadControl();
+    pageMerger = new PageMerger(mergeRate);
+    compressedPool = new CompressedPool((poolFrames == -1)
+					? NumPhysPages / 8 : poolFrames);
+    pageOutDaemon = new PageOutDaemon((pageOutTarget == -1)
+				? max(NumPhysPages / 16, 1) : pageOutTarget);
+#endif
+#ifdef USE_TLB
+    tlbManager = new TLBManager(tlbPolicy);
+#endif
+#ifdef FILESYS
+    if (checkpointFile != NULL)
+	printf("Can't checkpoint the Nachos file system; not checkpointing.\n");
+    else
+#endif
+    if ((checkpointFile != NULL) && (numCPUs > 1))
+	printf("Can't checkpoint with more than one CPU; not checkpointing.\n");
+    else if (checkpointFile != NULL)
+	ScheduleCheckpoint(checkpointFile, checkpointTime);
 #endif
 
 #ifdef FILESYS
@@ -20,6 +20,12 @@
 #include "synch.h"
 #include "system.h"
 #include "machine.h"
+#ifdef USER_PROGRAM
+#include "memorymanager.h"
+#endif
+#ifdef VM
+#include "loadcontrol.h"
+#endif
 
 
 #define STACK_FENCEPOST 0xdeadbeef	// this is put at the top of the
@@ -40,8 +46,10 @@ Thread::Thread(const char* threadName)
     stackTop = NULL;
     stack = NULL;
     status = JUST_CREATED;
+    numThreads++;
 #ifdef USER_PROGRAM
     space = NULL;
+    atUserBoundary = FALSE;
 #endif
 }
 
@@ -64,6 +72,7 @@ Thread::~Thread()
     ASSERT(this != currentThread);
     if (stack != NULL)
 	DeallocBoundedArray((char *) stack, StackSize * sizeof(int));
+    numThreads--;
 }
 
 //----------------------------------------------------------------------
@@ -202,7 +211,10 @@ Thread::Yield ()
 //	we have no thread to run.  "Interrupt::Idle" is called
 //	to signify that we should idle the CPU until the next I/O interrupt
 //	occurs (the only thing that could cause a thread to become
-//	ready to run).
+//	ready to run).  With user programs, the spare time is first put
+//	to use zeroing free frames, so that page faults needn't; and with
+//	VM, if the only processes that could run have been suspended by
+//	load control, one of them is let back in instead.
 //
 //	NOTE: we assume interrupts are already disabled, because it
 //	is called from the synchronization routines which must
@@ -221,8 +233,19 @@ Thread::Sleep ()
     DEBUG('t', "Sleeping thread \"%s\"\n", getName());
 
     status = BLOCKED;
-    while ((nextThread = scheduler->FindNextToRun()) == NULL)
+    while ((nextThread = scheduler->FindNextToRun()) == NULL) {
+	if (scheduler->LeaveCPU())
+	    return;		// another CPU has run us again
+#ifdef USER_PROGRAM
+	if (mm != NULL)
+	    mm->ZeroIdleFrames();
+#endif
+#ifdef VM
+	if ((loadControl != NULL) && loadControl->ResumeIdle())
+	    continue;		// it is ready to run now
+#endif
 	interrupt->Idle();	// no one to run, wait for an interrupt
+    }
         
     scheduler->Run(nextThread); // returns when we've been signalled
 }
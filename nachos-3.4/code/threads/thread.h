@@ -127,9 +127,16 @@ class Thread {
     void RestoreUserState();		// restore user-level register state
 
     AddrSpace *space;			// User code this thread is running.
+    bool atUserBoundary;		// switched out between two user
+					// instructions, so that its user
+					// registers and address space are
+					// all there is to it (see
+					// checkpoint.cc)
 #endif
 };
 
+extern int numThreads;			// # of Thread objects in existence
+
 // Magical machine-dependent routines, defined in switch.s
 
 extern "C" {
@@ -18,44 +18,32 @@
 #include "copyright.h"
 #include "system.h"
 #include "addrspace.h"
-#include "noff.h"
+#include "image.h"
+#include "profile.h"
+#ifdef USE_TLB
+#include "tlb.h"
+#endif
+#ifdef VM
+#include "swap.h"
+#include "frametable.h"
+#include "loadcontrol.h"
+#include "merge.h"
+#endif
 #ifdef HOST_SPARC
 #include <strings.h>
 #endif
 
-//----------------------------------------------------------------------
-// SwapHeader
-// 	Do little endian to big endian conversion on the bytes in the
-//	object file header, in case the file was generated on a little
-//	endian machine, and we're now running on a big endian machine.
-//----------------------------------------------------------------------
-
-static void
-SwapHeader (NoffHeader *noffH)
-{
-	noffH->noffMagic = WordToHost(noffH->noffMagic);
-	noffH->code.size = WordToHost(noffH->code.size);
-	noffH->code.virtualAddr = WordToHost(noffH->code.virtualAddr);
-	noffH->code.inFileAddr = WordToHost(noffH->code.inFileAddr);
-	noffH->initData.size = WordToHost(noffH->initData.size);
-	noffH->initData.virtualAddr = WordToHost(noffH->initData.virtualAddr);
-	noffH->initData.inFileAddr = WordToHost(noffH->initData.inFileAddr);
-	noffH->uninitData.size = WordToHost(noffH->uninitData.size);
-	noffH->uninitData.virtualAddr = WordToHost(noffH->uninitData.virtualAddr);
-	noffH->uninitData.inFileAddr = WordToHost(noffH->uninitData.inFileAddr);
-}
-
 //----------------------------------------------------------------------
 // AddrSpace::AddrSpace
-// 	Create an address space to run a user program.
-//	Load the program from a file "executable", and set everything
-//	up so that we can start executing user instructions.
+// 	Create an address space to run a user program in the file
+//	"executable", and set everything up so that we can start
+//	executing user instructions.
 //
 //	Assumes that the object code file is in NOFF format.
 //
-//	First, set up the translation from program memory to physical
-//	memory.  For now, this is really simple (1:1), since we are
-//	only uniprogramming, and we have a single unsegmented page table
+//	Nothing is loaded yet: every page starts out invalid, and is
+//	copied from the program's image (or zeroed) by PageIn, the first
+//	time the program touches it.  The image takes care of the file.
 //
 //	"executable" is the file containing the object code to load into memory
 //----------------------------------------------------------------------
@@ -69,27 +57,33 @@ AddrSpace::AddrSpace(OpenFile *executable)
     //MIPS simulator
     //Regular Mips exec - Common object file format (coff)
     //But, nachos needs Noff format
-    NoffHeader noffH;
     unsigned int i, size;
 
+    pcb = NULL;
+    profile = NULL;
+    tlbHits = tlbMisses = 0;
+    asid = asidGeneration = -1;
+    tlbEntriesOut = 0;
+#ifdef VM
+    swap = NULL;
+#endif
+    pageTable = NULL;
+    copyOnWrite = NULL;
+    prefetched = NULL;
+    numPages = 0;
+
     //reading header & verifying that heder has right value in it
     // verify that format is noff
-    executable->ReadAt((char *)&noffH, sizeof(noffH), 0);
-    if ((noffH.noffMagic != NOFFMAGIC) &&
-		(WordToHost(noffH.noffMagic) == NOFFMAGIC))
-    	SwapHeader(&noffH);
-
-
     //if not, return and set valie = false?
-    if(noffH.noffMagic != NOFFMAGIC) {
+    image = ProgramImage::Open(executable);
+    if (!image->IsValid()) {
         valid = false;
         return;
     }
 
 // how big is address space?
     //unInitData = heap
-    size = noffH.code.size + noffH.initData.size + noffH.uninitData.size
-			+ UserStackSize;	// we need to increase the size
+    size = image->Size() + UserStackSize;	// we need to increase the size
 						// to leave room for the stack
     //once i know the size (how many bytes in addy space), then
     //i can start dividing into pages
@@ -97,20 +91,18 @@ AddrSpace::AddrSpace(OpenFile *executable)
     numPages = divRoundUp(size, PageSize);
     size = numPages * PageSize;
 
+#ifndef VM
     //make sure numPages executable needs to run 
     // is less than or equal to the amount of 
     //physical mem the mips simulator is simulating
+    //(it may touch every page, and there is nowhere else to put them)
+    //with VM, pages that don't fit go to swap
     if(numPages > mm->GetFreePageCount()) {
 
         valid = false;
         return;
     }
-
-    // Allocate a new PCB for the address space
-
-  //  pcb = pcbManager->AllocatePCB();
-   // pcb->thread = currentThread;
-
+#endif
 
     DEBUG('a', "Initializing address space, num pages %d, size %d\n",
 					numPages, size);
@@ -118,52 +110,439 @@ AddrSpace::AddrSpace(OpenFile *executable)
     //page table entrys allow you to translate from virtual
     //page nums to physical frame nums
     //one entry in page table per page
-    //each entry has a bunch of info shows below
+    //no page has a frame until it is first touched
     pageTable = new TranslationEntry[numPages];
+    copyOnWrite = new bool[numPages];
     for (i = 0; i < numPages; i++) {
-        pageTable[i].virtualPage = i;	// for now, virtual page # = phys page #
-        pageTable[i].physicalPage = mm->AllocatePage();
-        pageTable[i].valid = TRUE;
+        copyOnWrite[i] = FALSE;
+        pageTable[i].virtualPage = i;
+        pageTable[i].physicalPage = 0;
+        pageTable[i].valid = FALSE;	// not loaded yet
         pageTable[i].use = FALSE;
         pageTable[i].dirty = FALSE;
         pageTable[i].readOnly = FALSE;  // if the code segment was entirely on
                         // a separate page, we could set its
                         // pages to be read-only
+    }
+    InitReadAhead();
+    valid = true;
+#ifdef VM
+    loadControl->Admit(this);
+#endif
+
+    //Loaded program
+    NoffHeader *noffH = image->Header();
+    printf("Loaded Program: [%d] code | [%d] data | [%d] bss\n", noffH->code.size, noffH->initData.size, noffH->uninitData.size);
+
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::PageIn
+// 	Handle a page fault at "virtAddr": give the page a frame, and
+//	fill it in from the program's image -- a copy of what is in the
+//	executable -- or, for uninitialized data and the stack, zeroes.
+//	With VM, the frame may be taken from some other page, and if
+//	this page was evicted dirty, it comes back from swap instead.
+//
+//	A page of nothing but code is mapped read-only, and shared with
+//	every other address space running the same program: if one of
+//	them has already loaded it, we just map the same frame.  A page
+//	that starts out all zeroes (past the end of the initialized
+//	data) is mapped to the one frame of zeroes everybody shares,
+//	copy-on-write; it gets a frame of its own the first time the
+//	program writes to it.
+//
+//	Returns FALSE if "virtAddr" isn't in the address space at all,
+//	or there is no frame for it.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::PageIn(int virtAddr)
+{
+    unsigned int vpn = (unsigned) virtAddr >> PageShift;
+
+    if (vpn >= numPages)
+	return FALSE;
+    if (pageTable[vpn].valid)
+	return TRUE;
+    if (!Load(vpn))
+	return FALSE;
+    stats->numPageFaults++;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Load
+// 	Bring in invalid page "vpn", as described for PageIn: map a
+//	shared frame, or fill in one of our own.  Used both for page
+//	faults and for reading ahead of them.
+//
+//	Returns FALSE if there is no frame for it.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::Load(unsigned int vpn)
+{
+    TranslationEntry *entry = &pageTable[vpn];
+    bool saved = FALSE;			// evicted dirty, so in swap?
+    int frame, bytes;
+
+    ASSERT(!entry->valid);
+#ifdef VM
+    saved = (swap != NULL) && swap->Has(vpn);
+#endif
+    if ((image == NULL) || saved)
+	frame = -1;
+    else if (image->IsText(vpn))
+	frame = image->TextFrame(vpn);	// (-1 if no one has loaded it)
+    else if (image->IsZero(vpn))
+	frame = mm->ZeroFrame();	// (-1 if memory is full)
+    else
+	frame = -1;
+    if (frame != -1) {
+	mm->Share(frame);
+#ifdef VM
+	frameTable->Map(frame, this, vpn);
+#endif
+	entry->physicalPage = frame;
+	entry->valid = TRUE;
+	entry->use = entry->dirty = FALSE;
+	entry->readOnly = TRUE;
+	copyOnWrite[vpn] = mm->IsZeroFrame(frame);
+	if (mm->IsZeroFrame(frame))
+	    stats->numZeroMapped++;
+	else
+	    stats->numTextShared++;
+	DEBUG('a', "Page in: virtual page %d -> shared frame %d\n",
+		vpn, frame);
+	return TRUE;
+    }
+#ifdef VM
+    frame = frameTable->GetFrame(this, vpn, FALSE);
+#else
+    frame = mm->AllocatePage();
+#endif
+    if (frame == -1)
+	return FALSE;
+
+#ifdef VM
+    if (saved) {
+	swap->Read(vpn, &machine->mainMemory[frame * PageSize]);
+	bytes = PageSize;
+    } else
+#endif
+    {
+	ASSERT(image != NULL);		// (restored spaces start out loaded)
+	bytes = image->LoadPage(vpn, &machine->mainMemory[frame * PageSize]);
+    }
+    entry->physicalPage = frame;
+    entry->valid = TRUE;
+    entry->use = entry->dirty = FALSE;
+    entry->readOnly = FALSE;		// (it is ours alone now)
+    copyOnWrite[vpn] = FALSE;
+    if ((image != NULL) && image->IsText(vpn)) {
+	entry->readOnly = TRUE;
+	if (image->TextFrame(vpn) == -1)	// (unless someone beat us
+	    image->SetTextFrame(vpn, frame);	// to it while we read)
+    }
+#ifdef VM
+    frameTable->Unlock(frame);
+#endif
+    DEBUG('a', "Page in: virtual page %d -> frame %d, %d bytes copied\n",
+		vpn, frame, bytes);
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::ReadAhead
+// 	The program has just faulted on the page at "virtAddr".  If that
+//	continues a sequential run of faults -- it is the page after the
+//	last one we loaded for the run -- load the next few pages as well,
+//	so that the program finds them there, instead of faulting on each
+//	in turn.  Otherwise, start following a new run from this page, in
+//	place of the run we have heard from least recently.
+//
+//	Every time the program gets through what we read ahead and
+//	faults on the next page, we read twice as far ahead.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::ReadAhead(int virtAddr)
+{
+    int vpn = (unsigned) virtAddr >> PageShift;
+    int s;
+
+    for (s = 0; s < ReadAheadStreams; s++)
+	if (streamNext[s] == vpn)
+	    break;
+    if (s == ReadAheadStreams) {
+	s = nextStream;
+	nextStream = (nextStream + 1) % ReadAheadStreams;
+	streamNext[s] = vpn + 1;
+	return;
+    }
+    if (readAheadWindow == 0)
+	readAheadWindow = MinReadAhead;
+    else
+	readAheadWindow = min(readAheadWindow * 2, MaxReadAhead);
+    streamNext[s] = vpn + 1 + Prefetch(vpn + 1, readAheadWindow);
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Prefetch
+// 	Load whichever of the "count" pages from "first" on aren't in
+//	memory, as long as there are free frames to spare: reading ahead
+//	is only a guess, so we don't take frames from other pages for
+//	it, or leave none for the next real fault.  Pages in the swap
+//	file are read a run at a time.
+//
+//	Returns how many of the pages we got through.
+//----------------------------------------------------------------------
 
-        // Zero out each page, to zero the unitialized data segment
-        // and the stack segment
-        // nothing has been executed yet so unInit data (heap) & stack are empty rn
-        unsigned int physicalPageAddress = (pageTable[i].physicalPage)*128;
-        bzero(&(machine->mainMemory[physicalPageAddress]), 128);
+int
+AddrSpace::Prefetch(int first, int count)
+{
+    int vpn, end = min(first + count, (int) numPages);
+
+    for (vpn = first; vpn < end; vpn++) {
+	if (pageTable[vpn].valid)
+	    continue;
+	if ((int) mm->GetFreePageCount() <= NumPhysPages / ReadAheadReserve)
+	    break;
+#ifdef VM
+	if ((swap != NULL) && swap->OnDisk(vpn)) {
+	    int n = PrefetchSwapped(vpn, end);
+
+	    if (n == 0)
+		break;
+	    vpn += n - 1;
+	    continue;
+	}
+#endif
+	if (!Load(vpn))
+	    break;
+	prefetched[vpn] = TRUE;
+	readAheadPages++;
+	stats->numReadAheadPages++;
     }
+    DEBUG('a', "Read ahead: virtual pages %d to %d\n", first, vpn - 1);
+    return vpn - first;
+}
+
+#ifdef VM
+//----------------------------------------------------------------------
+// AddrSpace::PrefetchSwapped
+// 	Load the run of pages from "first" on (and before "end") that are
+//	in the swap file on disk, not in the compressed pool, with a
+//	single read.  Each gets a free frame, while there are frames to
+//	spare.
+//
+//	Returns how many pages were loaded.
+//----------------------------------------------------------------------
 
-     // then, copy in the code and initData segments into memory
-    if (noffH.code.size > 0) {
-        DEBUG('a', "Initializing code segment, at 0x%x, size %d\n",
-			noffH.code.virtualAddr, noffH.code.size);
-        ReadFile(executable, noffH.code.inFileAddr, noffH.code.virtualAddr, noffH.code.size);
+int
+AddrSpace::PrefetchSwapped(int first, int end)
+{
+    int frames[MaxReadAhead];
+    char *into[MaxReadAhead];
+    TranslationEntry *entry;
+    int n, i;
+
+    ASSERT(end - first <= MaxReadAhead);
+    for (n = 0; first + n < end; n++) {
+	if (pageTable[first + n].valid || !swap->OnDisk(first + n)
+		|| ((int) mm->GetFreePageCount()
+			<= NumPhysPages / ReadAheadReserve))
+	    break;
+	frames[n] = frameTable->GetFrame(this, first + n, FALSE);
+	if (frames[n] == -1)
+	    break;
+	into[n] = &machine->mainMemory[frames[n] * PageSize];
     }
-    //
-    if (noffH.initData.size > 0) {
-        DEBUG('a', "Initializing data segment, at 0x%x, size %d\n",
-			noffH.initData.virtualAddr, noffH.initData.size);
-        ReadFile(executable, noffH.initData.inFileAddr, noffH.initData.virtualAddr, noffH.initData.size);
+    if (n == 0)
+	return 0;
+    swap->ReadRun(first, n, into);
+    for (i = 0; i < n; i++) {
+	entry = &pageTable[first + i];
+	entry->physicalPage = frames[i];
+	entry->valid = TRUE;
+	entry->use = entry->dirty = FALSE;
+	entry->readOnly = FALSE;
+	copyOnWrite[first + i] = FALSE;
+	prefetched[first + i] = TRUE;
+	frameTable->Unlock(frames[i]);
     }
-    valid = true;
+    readAheadPages += n;
+    stats->numReadAheadPages += n;
+    return n;
+}
+#endif
 
-    //Loaded program
-    printf("Loaded Program: [%d] code | [%d] data | [%d] bss\n", noffH.code.size, noffH.initData.size, noffH.uninitData.size);
+//----------------------------------------------------------------------
+// AddrSpace::ReadAheadUsed
+// 	Page "vpn" has been touched; if we read it ahead, that was worth
+//	doing.  Called when the page goes into the TLB, or when the
+//	kernel touches it for us.
+//----------------------------------------------------------------------
 
+void
+AddrSpace::ReadAheadUsed(int vpn)
+{
+    if (!prefetched[vpn])
+	return;
+    prefetched[vpn] = FALSE;
+    readAheadHits++;
+    stats->numReadAheadHits++;
 }
 
+//----------------------------------------------------------------------
+// AddrSpace::ReadAheadLost
+// 	Page "vpn" is being evicted, or the address space is going away.
+//	If we read the page ahead and it still hasn't been touched,
+//	reading it was wasted, and we were reading too far ahead: halve
+//	the window.
+//----------------------------------------------------------------------
 
-void AddrSpace::ReadFile(OpenFile *file, int offset, int virtualAddr, int size) {
-    int counter = 0;
-    while( counter < size) {
-        file->ReadAt(&(machine->mainMemory[Translate(virtualAddr+counter)]),
-            1, offset+counter);
-        counter++;
+void
+AddrSpace::ReadAheadLost(int vpn)
+{
+    if (!prefetched[vpn])
+	return;
+    if (pageTable[vpn].use) {		// (but not through the TLB)
+	ReadAheadUsed(vpn);
+	return;
     }
+    prefetched[vpn] = FALSE;
+    readAheadMisses++;
+    stats->numReadAheadMisses++;
+    readAheadWindow /= 2;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::InitReadAhead
+// 	Set up to read ahead of page faults: no runs of faults seen, and
+//	no pages read ahead.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::InitReadAhead()
+{
+    prefetched = new bool[numPages];
+    for (unsigned int i = 0; i < numPages; i++)
+	prefetched[i] = FALSE;
+    for (int s = 0; s < ReadAheadStreams; s++)
+	streamNext[s] = -1;
+    nextStream = 0;
+    readAheadWindow = 0;
+    readAheadPages = readAheadHits = readAheadMisses = 0;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::CopyOnWrite
+// 	Handle a write to the read-only page at "virtAddr".  If it is
+//	only read-only because its frame is shared copy-on-write, give
+//	this address space a copy of its own -- or, if nobody else maps
+//	the frame any more, just let us write to it.  A page mapped to
+//	the shared frame of zeroes always gets a frame of its own, which
+//	is zeroed rather than copied (ahead of time, if the idle loop
+//	has got to it).
+//
+//	Returns FALSE if the page really is read-only, or there is no
+//	frame for the copy.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::CopyOnWrite(int virtAddr)
+{
+    unsigned int vpn = (unsigned) virtAddr >> PageShift;
+    TranslationEntry *entry;
+    int frame, copy;
+    bool zero;
+
+    if (!IsCopyOnWrite(virtAddr))
+	return FALSE;
+    entry = &pageTable[vpn];
+    ASSERT(entry->valid);
+    stats->numCOWFaults++;
+#ifdef USE_TLB
+    tlbManager->Evict(this, vpn);	// it has the page read-only
+#endif
+
+    frame = entry->physicalPage;
+    zero = mm->IsZeroFrame(frame);
+    if (mm->RefCount(frame) > 1) {
+#ifdef VM
+	frameTable->Lock(frame);	// (so it isn't evicted as we copy it)
+	copy = frameTable->GetFrame(this, vpn, zero);
+	frameTable->Unlock(frame);
+#else
+	copy = zero ? mm->AllocateZeroedPage() : mm->AllocatePage();
+#endif
+	if (copy == -1)
+	    return FALSE;
+	if (!zero)
+	    bcopy(&machine->mainMemory[frame * PageSize],
+		&machine->mainMemory[copy * PageSize], PageSize);
+#ifdef VM
+	frameTable->Release(frame, this, vpn);
+	frameTable->Unlock(copy);
+#else
+	mm->DeallocatePage(frame);
+#endif
+	entry->physicalPage = copy;
+	stats->numCOWCopies++;
+	DEBUG('a', "Copy on write: virtual page %d, frame %d -> %d\n", vpn,
+		frame, copy);
+    }
+    entry->readOnly = FALSE;
+    copyOnWrite[vpn] = FALSE;
+    machine->FlushSoftTLB();
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::IsCopyOnWrite
+// 	Return TRUE if the page at "virtAddr" is shared copy-on-write.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::IsCopyOnWrite(int virtAddr)
+{
+    unsigned int vpn = (unsigned) virtAddr >> PageShift;
+
+    return (vpn < numPages) && copyOnWrite[vpn];
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::LoadAll
+// 	Load every page that hasn't been touched yet, so that the
+//	address space no longer needs its executable.
+//
+//	Returns FALSE if memory runs out first.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::LoadAll()
+{
+    for (unsigned int i = 0; i < numPages; i++)
+	if (!PageIn(i * PageSize))
+	    return FALSE;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::IsResident
+// 	Return TRUE if every page is in main memory.  (With VM, loading
+//	one page may have evicted another.)
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::IsResident()
+{
+    for (unsigned int i = 0; i < numPages; i++)
+	if (!pageTable[i].valid)
+	    return FALSE;
+    return TRUE;
 }
 
 TranslationEntry* AddrSpace::GetPageTable() {
@@ -174,76 +553,203 @@ unsigned int AddrSpace::GetNumPages() {
     return numPages;
 }
 
+//----------------------------------------------------------------------
+// AddrSpace::StartProfile
+// 	If user programs are being profiled ("-P"), start counting the
+//	instructions this address space runs.  "fileName" is the
+//	program's NOFF file, used to find its symbols at the end.
+//
+//	The profile outlives the address space, so that it can be
+//	printed when Nachos halts.
+//----------------------------------------------------------------------
+
+void AddrSpace::StartProfile(const char *fileName)
+{
+    if (profileUserPrograms)
+        profile = new UserProfile(fileName, numPages * PageSize);
+}
+
 
 //----------------------------------------------------------------------
 // AddrSpace::AddrSpace
-// 	Create an address space as a copy of an existing one
+// 	Create an address space as a copy of an existing one, for Fork.
+//
+//	Nothing is copied yet: the child shares every frame the parent
+//	has, read-only in both address spaces, and CopyOnWrite gives
+//	whichever of them writes to a page first a copy of its own.
+//	Pages the parent hasn't loaded yet, the child loads for itself.
+//	So a fork costs about the size of the page table, and needs no
+//	free frames at all.
 //----------------------------------------------------------------------
 
 AddrSpace::AddrSpace(AddrSpace* space) {
 
     valid = true;
+    pcb = NULL;
+    profile = NULL;
+    tlbHits = tlbMisses = 0;
+    asid = asidGeneration = -1;
+    tlbEntriesOut = 0;
+#ifdef VM
+    swap = NULL;
+    loadControl->Admit(this);
+#endif
 
-    // 1. Find how big the parent/source address space is
+    // 1. Find how big the parent/source address space is; its
+    // unloaded pages we load from the same file
     unsigned int n = space->GetNumPages();
+    TranslationEntry* ppt = space->GetPageTable();
+    image = space->image;
+    if (image != NULL)
+        image->Hold();
 
     // Acquire mmLock
     //ensures that no other process can try to copy the parent pg table
     //at the same time
     mmLock->Acquire();
 
-    // 2. Check if there is enough free memory to make the copy. IF not, fail
-    //ASSERT(n <= mm->GetFreePageCount());
-    if(n > mm->GetFreePageCount()){
-        valid = false;
-        return;
-    }
-    // Change this to informiing caller that constructor failed using valid=false;
-   // pcb = pcbManager->AllocatePCB();
+#ifdef USE_TLB
+    // 2. The parent's use and dirty bits may still be in the TLB
+    tlbManager->Sync();
+#endif
+
     // 3. Create a new pagetable of same size as source addr space
     pageTable = new TranslationEntry[n];
+    copyOnWrite = new bool[n];
     numPages = n;
+    InitReadAhead();
 
-    // 4. Make a copy of the PTEs but allocate new physical pages
-    //get parent pg table
-    TranslationEntry* ppt = space->GetPageTable();
+    // 4. Make a copy of the PTEs, sharing the parent's frames
     for (unsigned int i = 0; i < numPages; i++) {
         pageTable[i].virtualPage = ppt[i].virtualPage;
-        pageTable[i].physicalPage = mm->AllocatePage();
+        pageTable[i].physicalPage = ppt[i].physicalPage;
         pageTable[i].valid = ppt[i].valid;
         pageTable[i].use = ppt[i].use;
         pageTable[i].dirty = ppt[i].dirty;
         pageTable[i].readOnly = ppt[i].readOnly;
-
-        // 5. For each page, make an actual copy of the contents of the page
-        //takes the following params, in order:
-        // 1. starting byte address of the parent pg table
-        // 2. starting byte address of the child pg table
-        // 3. # of bytes we want to copy (in this case, = to size of page)
-        // Divide by 28 to get first byte addy bc each page has 128 bytes
-        bcopy(  &(machine->mainMemory[ppt[i].physicalPage*128]),
-                &(machine->mainMemory[pageTable[i].physicalPage*128]),
-                128);
+        copyOnWrite[i] = space->copyOnWrite[i];
+
+        if (ppt[i].valid) {
+            // 5. A writable page becomes read-only for both of us, until
+            // one of us writes to it
+            if (!ppt[i].readOnly) {
+                ppt[i].readOnly = pageTable[i].readOnly = TRUE;
+                space->copyOnWrite[i] = copyOnWrite[i] = TRUE;
+#ifdef USE_TLB
+                tlbManager->Evict(space, i);    // (it has it writable)
+#endif
+            }
+            mm->Share(ppt[i].physicalPage);
+#ifdef VM
+            frameTable->Map(ppt[i].physicalPage, this, i);
+            // unless the parent could reload it from the executable,
+            // the child has no copy of the page but this one
+            if ((space->swap != NULL) && space->swap->Has(i))
+                pageTable[i].dirty = TRUE;
+#endif
+        }
+#ifdef VM
+        else if ((space->swap != NULL) && space->swap->Has(i)) {
+            // 6. The parent's copy is in its swap file; read the child
+            // its own (which may evict some other page)
+            int frame = frameTable->GetFrame(this, i, FALSE);
+            ASSERT(frame != -1);
+            space->swap->Read(i, &machine->mainMemory[frame*PageSize]);
+            pageTable[i].physicalPage = frame;
+            pageTable[i].valid = TRUE;
+            pageTable[i].dirty = TRUE;
+            pageTable[i].readOnly = FALSE;
+            copyOnWrite[i] = FALSE;
+            frameTable->Unlock(frame);
+        }
+#endif
     }
+    machine->FlushSoftTLB();            // it had the parent's pages writable
 
     // Release mmLock
     mmLock->Release();
 
+    // The child runs the same program; give it a profile of its own.
+    if (space->profile != NULL)
+        StartProfile(space->profile->FileName());
 }
 
 
 
+//----------------------------------------------------------------------
+// AddrSpace::AddrSpace
+// 	Rebuild an address space saved in a checkpoint.  The caller has
+//	already claimed its frames and put their contents back into
+//	main memory; we just take over the page table.
+//
+//	"table" is the saved page table, with "n" entries
+//	"cow" says which of its pages are shared copy-on-write
+//----------------------------------------------------------------------
+
+AddrSpace::AddrSpace(TranslationEntry *table, bool *cow, unsigned int n)
+{
+    pageTable = table;
+    copyOnWrite = cow;
+    numPages = n;
+    InitReadAhead();
+    image = NULL;			// (every page was loaded)
+    pcb = NULL;
+    profile = NULL;
+    tlbHits = tlbMisses = 0;
+    asid = asidGeneration = -1;
+    tlbEntriesOut = 0;
+#ifdef VM
+    swap = NULL;
+    loadControl->Admit(this);
+
+    // Let the frames be evicted like any others.  Memory holds the
+    // only copy of each page, so they are all dirty.
+    for (unsigned int i = 0; i < numPages; i++)
+        if (pageTable[i].valid) {
+            frameTable->Map(pageTable[i].physicalPage, this, i);
+            pageTable[i].dirty = TRUE;
+        }
+#endif
+    valid = true;
+}
+
 //----------------------------------------------------------------------
 // AddrSpace::~AddrSpace
-// 	Dealloate an address space.  Nothing for now!
+// 	Dealloate an address space.  With a TLB, also drop any of our
+//	translations still in it.  With "-d a", report how well the TLB
+//	and read-ahead did for us; Statistics has the totals.
 //----------------------------------------------------------------------
 
 AddrSpace::~AddrSpace()
 {
+#ifdef USE_TLB
+    tlbManager->Forget(this);
+    DEBUG('a', "TLB: [%d] hits %d, misses %d\n",
+        (pcb != NULL) ? pcb->pid : -1, tlbHits, tlbMisses);
+#endif
     for (unsigned int i = 0; i < numPages; i++) {
-        mm->DeallocatePage(pageTable[i].physicalPage);
+        ReadAheadLost(i);               // (if it was never touched)
+        if (pageTable[i].valid)
+#ifdef VM
+            frameTable->Release(pageTable[i].physicalPage, this, i);
+#else
+            mm->DeallocatePage(pageTable[i].physicalPage);
+#endif
     }
+   if (readAheadPages > 0)
+       DEBUG('a', "Read-ahead: [%d] %d pages, %d used, %d wasted (%d%%)\n",
+           (pcb != NULL) ? pcb->pid : -1, readAheadPages, readAheadHits,
+           readAheadMisses, readAheadHits * 100 / readAheadPages);
    delete pageTable;
+   delete [] copyOnWrite;
+   delete [] prefetched;
+#ifdef VM
+   if (swap != NULL)
+       delete swap;
+   loadControl->Leave(this);		// (and report how we did)
+#endif
+   if (image != NULL)
+       image->Release();
 }
 
 //----------------------------------------------------------------------
@@ -283,32 +789,63 @@ AddrSpace::InitRegisters()
 // 	On a context switch, save any machine state, specific
 //	to this address space, that needs saving.
 //
-//	For now, nothing!
+//	For now, nothing!  With VM, though, load control keeps track
+//	of how long we run.
 //----------------------------------------------------------------------
 
 void AddrSpace::SaveState()
-{}
+{
+#ifdef VM
+    loadControl->Stopped(this);
+#endif
+}
 
 //----------------------------------------------------------------------
 // AddrSpace::RestoreState
 // 	On a context switch, restore the machine state so that
 //	this address space can run.
 //
-//      For now, tell the machine where to find the page table.
+//      For now, tell the machine where to find the page table (or,
+//	with a TLB, which address space identifier to match), and forget
+//	the translations it cached for the last one.
+//	Also switch the machine over to this address space's profile.
 //----------------------------------------------------------------------
 
 void AddrSpace::RestoreState()
 {
+#ifdef VM
+    pageMerger->Scan();			// (look for frames to merge)
+#endif
+#ifdef USE_TLB
+    tlbManager->Switch(this);		// our TLB entries may still be there
+#else
     machine->pageTable = pageTable;
     machine->pageTableSize = numPages;
+#endif
+    machine->FlushSoftTLB();
+    machine->profile = profile;
+    if ((profile != NULL) && (pcb != NULL))
+        profile->pid = pcb->pid;
+#ifdef VM
+    loadControl->Running(this);
+#endif
 }
 
 
-// perform MMU translation to access physical memory
-unsigned int AddrSpace::Translate(unsigned int virtualAddr) {
+// perform MMU translation to access physical memory; returns FALSE,
+// like a page fault the program can't recover from, if "virtualAddr"
+// isn't in the address space or there is no frame to load it into
+bool AddrSpace::Translate(unsigned int virtualAddr,
+                          unsigned int *physicalAddr) {
         unsigned int pageNumber = virtualAddr/PageSize;
         unsigned int pageOffset = virtualAddr%PageSize;
+        if (pageNumber >= numPages)
+            return FALSE;
+        if (!pageTable[pageNumber].valid         // the kernel touched it first
+                && !PageIn(virtualAddr))
+            return FALSE;
+        ReadAheadUsed(pageNumber);
         unsigned int frameNumber = pageTable[pageNumber].physicalPage;
-        int physicalAddr = frameNumber*PageSize + pageOffset;
-        return physicalAddr;
+        *physicalAddr = frameNumber*PageSize + pageOffset;
+        return TRUE;
 }
\ No newline at end of file
@@ -18,14 +18,34 @@
 #include "pcb.h"
 
 class PCB;
+class UserProfile;
+class ProgramImage;
+class SwapFile;
 #define UserStackSize		1024 	// increase this as necessary!
 
+// Read-ahead: when a program faults on the page right after one it
+// faulted on (or right after the pages we read ahead for it), we load
+// the next few pages too, before it asks for them.  We follow up to
+// ReadAheadStreams sequential runs of faults at once -- one per array
+// the program sweeps through -- and read ahead from MinReadAhead up to
+// MaxReadAhead pages, doubling each time the program runs through what
+// we read, and halving each time a page we read is evicted unused.  We
+// only read ahead into free frames, and never into the last
+// NumPhysPages / ReadAheadReserve of them.
+#define ReadAheadStreams	4
+#define MinReadAhead		2
+#define MaxReadAhead		16
+#define ReadAheadReserve	8
+
 class AddrSpace {
   public:
-    AddrSpace(OpenFile *executable);	// Create an address space,
-					// initializing it with the program
-					// stored in the file "executable"
+    AddrSpace(OpenFile *executable);	// Create an address space for
+					// the program stored in the file
+					// "executable", which it closes
     AddrSpace(AddrSpace* space);
+    AddrSpace(TranslationEntry *table, bool *cow, unsigned int n);
+					// Rebuild an address space from
+					// a checkpoint (see checkpoint.cc)
     ~AddrSpace();			// De-allocate an address space
 
     void InitRegisters();		// Initialize user-level CPU registers,
@@ -35,16 +55,62 @@ class AddrSpace {
     void RestoreState();		// info on a context switch 
     unsigned int GetNumPages();
     TranslationEntry* GetPageTable();
-    unsigned int Translate(unsigned int virtualAddr);
+    bool *GetCopyOnWrite() { return copyOnWrite; }
+    bool Translate(unsigned int virtualAddr, unsigned int *physicalAddr);
+					// FALSE if it can't be loaded
     PCB* pcb; // the process that owns this addresspace
     bool valid; // is AddrSpace valid
-    void ReadFile(OpenFile *file, int offset, int virtualAddr, int size); // Read from file into a user process' virtual address space.
+    bool PageIn(int virtAddr);		// Load the page "virtAddr" is on,
+					// the first time it is touched
+    void ReadAhead(int virtAddr);	// ... and maybe some after it
+    void ReadAheadUsed(int vpn);	// Page "vpn" has been touched
+    void ReadAheadLost(int vpn);	// ... or is being evicted
+    bool CopyOnWrite(int virtAddr);	// Un-share the page "virtAddr" is
+					// on, the first time it is written
+    bool IsCopyOnWrite(int virtAddr);
+    bool LoadAll();			// Load every page not loaded yet
+    bool IsResident();			// Is every page in memory?
+    void StartProfile(const char *fileName);	// Profile the program in
+					// "fileName", if "-P" was given
+    UserProfile *profile;		// NULL if not being profiled
+    int tlbHits, tlbMisses;		// TLB performance, with USE_TLB
+    int asid;				// tags our TLB entries; valid only
+    int asidGeneration;			// while this matches the TLB
+					// manager's (see tlb.h)
+    int tlbEntriesOut;			// our TLB entries when we were last
+					// switched out
+#ifdef VM
+    SwapFile *swap;			// where our dirty pages go when
+					// they are evicted; NULL until then
+#endif
 
   private:
     TranslationEntry *pageTable;	// Assume linear page table translation
 					// for now!
     unsigned int numPages;		// Number of pages in the virtual 
 					// address space
+    ProgramImage *image;		// where pages come from when they
+					// are first touched
+    bool *copyOnWrite;			// per page: read-only only because
+					// its frame is shared since a Fork
+    bool *prefetched;			// per page: read ahead, and not
+					// touched yet
+    int streamNext[ReadAheadStreams];	// the page that would continue
+					// each sequential run of faults
+    int nextStream;			// the one to replace next
+    int readAheadWindow;		// how many pages to read ahead
+    int readAheadPages, readAheadHits, readAheadMisses;
+					// pages read ahead, and how many
+					// were used, or evicted unused
+
+    bool Load(unsigned int vpn);	// Give page "vpn" a frame, and
+					// fill it in
+    int Prefetch(int first, int count);	// Load pages ahead of a fault
+#ifdef VM
+    int PrefetchSwapped(int first, int end);
+					// ... from the swap file, at once
+#endif
+    void InitReadAhead();		// No pages read ahead yet
 };
 
 #endif // ADDRSPACE_H
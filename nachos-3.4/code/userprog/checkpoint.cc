@@ -0,0 +1,434 @@
+// checkpoint.cc
+//	Routines to checkpoint the user programs to a file, and to
+//	restart them from it.  See checkpoint.h.
+//
+//	A checkpoint file holds, in order:
+//		a CheckpointHeader (geometry, Statistics, # of threads)
+//		for each ready thread, in ready list order: a
+//		  CheckpointThread, its page table, which of its pages
+//		  are copy-on-write, and the pid and exit status of
+//		  each of its exited, un-joined children
+//		main memory, starting at a page-aligned offset, so that
+//		  the image could just as well be mapped as read
+//
+//	Pages a program hasn't touched yet are loaded first, since the
+//	restored address space has no executable to load them from;
+//	so, with VM, every process must fit in memory at once.
+//
+//	Open files are not saved; a restored program starts with none
+//	open, though with the stub file system its files are still there
+//	on the host to open again.  The Nachos file system lives on the
+//	simulated disk, which we don't save, so with FILESYS we refuse
+//	to checkpoint or restore at all.
+//
+//	Nothing else needs saving.  Since no thread is in the kernel,
+//	no device I/O can be in progress; the only pending interrupt
+//	is the timer, and Initialize has already re-armed it.  The
+//	predecode and soft TLB caches of the new machine start out
+//	empty, and fill up again from main memory as the programs run.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "addrspace.h"
+#include "synch.h"
+#include "memorymanager.h"
+#include "pcbmanager.h"
+#include "checkpoint.h"
+#ifdef VM
+#include "pageout.h"
+#endif
+
+#define CheckpointAlign		4096	// main memory starts at a multiple
+					// of this in the file
+#define NameLength		32	// longest thread name we keep
+
+class CheckpointHeader {
+  public:
+    int magic;			// CheckpointMagic
+    int pageSize;		// machine geometry; must match when
+    int numPhysPages;		// we restore
+    int numRegs;
+    int numThreads;		// # of CheckpointThreads that follow
+    int memoryOffset;		// where main memory is, in the file
+    Statistics stats;		// simulated time, etc.
+};
+
+class CheckpointThread {
+  public:
+    char name[NameLength];
+    int registers[NumTotalRegs];	// user registers
+    int numPages;		// # of page table entries that follow
+    int pid;			// -1 if the process has no PCB
+    int parentPid;		// -1 if none
+    int exitStatus;
+    int numExited;		// # of exited children that follow
+};
+
+class CheckpointChild {
+  public:
+    int pid;
+    int exitStatus;
+};
+
+static const char *checkpointFile;	// where to write the checkpoint
+static Semaphore *checkpointDue;	// V'ed when it's time to try
+static int checkpointFd;		// the file, while we write it
+static int numExited;			// exited children, counted by
+					// CountExited
+static bool allLoaded;			// FALSE if LoadProcess ran out of
+					// memory
+
+//----------------------------------------------------------------------
+// CheckpointInterrupt
+// 	Interrupt handler for the checkpoint "device": wake up the
+//	checkpoint thread, and switch out whatever thread is running,
+//	so it gets to run at once.
+//----------------------------------------------------------------------
+
+static void
+CheckpointInterrupt(int arg)
+{
+    checkpointDue->V();
+    interrupt->YieldOnReturn();
+}
+
+//----------------------------------------------------------------------
+// CountExited, WriteExited
+// 	Count, and write out, a process's children that have exited but
+//	not been joined yet.  Called via Mapcar on its list of children.
+//----------------------------------------------------------------------
+
+static void
+CountExited(int arg)
+{
+    if (((PCB *) arg)->HasExited())
+	numExited++;
+}
+
+static void
+WriteExited(int arg)
+{
+    PCB *pcb = (PCB *) arg;
+    CheckpointChild child;
+
+    if (pcb->HasExited()) {
+	child.pid = pcb->pid;
+	child.exitStatus = pcb->exitStatus;
+	WriteFile(checkpointFd, (char *) &child, sizeof(child));
+    }
+}
+
+//----------------------------------------------------------------------
+// LoadProcess
+// 	Load every page of a ready thread's address space that it hasn't
+//	touched yet.  Called via Mapcar on the ready threads.
+//----------------------------------------------------------------------
+
+static void
+LoadProcess(int arg)
+{
+    if (!((Thread *) arg)->space->LoadAll())
+	allLoaded = FALSE;
+}
+
+//----------------------------------------------------------------------
+// CheckResident
+// 	Make sure LoadProcess didn't push any page out to swap, which
+//	the checkpoint doesn't save.  Called via Mapcar on the ready
+//	threads.
+//----------------------------------------------------------------------
+
+static void
+CheckResident(int arg)
+{
+    if (!((Thread *) arg)->space->IsResident())
+	allLoaded = FALSE;
+}
+
+//----------------------------------------------------------------------
+// WriteProcess
+// 	Write out the state of a user thread that is ready to run.
+//	Called via Mapcar on the ready threads.
+//----------------------------------------------------------------------
+
+static void
+WriteProcess(int arg)
+{
+    Thread *thread = (Thread *) arg;
+    AddrSpace *space = thread->space;
+    PCB *pcb = space->pcb;
+    CheckpointThread rec;
+    int i;
+
+    memset(&rec, 0, sizeof(rec));
+    strncpy(rec.name, thread->getName(), NameLength - 1);
+    thread->RestoreUserState();		// (it's not running: just a way
+					// to get at its user registers)
+    for (i = 0; i < NumTotalRegs; i++)
+	rec.registers[i] = machine->ReadRegister(i);
+    rec.numPages = space->GetNumPages();
+    rec.pid = rec.parentPid = -1;
+    rec.numExited = 0;
+    if (pcb != NULL) {
+	rec.pid = pcb->pid;
+	rec.exitStatus = pcb->exitStatus;
+	if (pcb->parent != NULL)
+	    rec.parentPid = pcb->parent->pid;
+	numExited = 0;
+	pcb->GetChildren()->Mapcar(CountExited);
+	rec.numExited = numExited;
+    }
+    WriteFile(checkpointFd, (char *) &rec, sizeof(rec));
+    WriteFile(checkpointFd, (char *) space->GetPageTable(),
+				rec.numPages * sizeof(TranslationEntry));
+    WriteFile(checkpointFd, (char *) space->GetCopyOnWrite(),
+				rec.numPages * sizeof(bool));
+    if (pcb != NULL)
+	pcb->GetChildren()->Mapcar(WriteExited);
+}
+
+//----------------------------------------------------------------------
+// TakeCheckpoint
+// 	Write the checkpoint, if every thread other than this one is
+//	a user thread, ready to run, that was switched out between
+//	two user instructions -- or, with VM, the page-out daemon,
+//	waiting to be woken, which has nothing to save.
+//
+//	Returns FALSE if the system isn't in such a state, and we
+//	should try again later.
+//----------------------------------------------------------------------
+
+static bool
+TakeCheckpoint()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    List *ready = new List;
+    CheckpointHeader header;
+    Thread *thread;
+    bool quiet = TRUE;
+    int fd, n = 0, expected;
+    char zero = 0;
+
+    // Take the threads off the ready list, to look at them, and so
+    // that they go back on in the same order.
+    while ((thread = scheduler->FindNextToRun()) != NULL) {
+	ready->Append((void *) thread);
+	if ((thread->space == NULL) || !thread->atUserBoundary)
+	    quiet = FALSE;
+	n++;
+    }
+    expected = n + 1;			// (the ready threads, and us)
+#ifdef VM
+    if (pageOutDaemon->IsIdle())
+	expected++;			// (it waits for work, harmlessly)
+#endif
+    if (numThreads != expected)		// someone else is blocked
+	quiet = FALSE;
+
+    allLoaded = TRUE;
+    if (quiet) {
+	ready->Mapcar(LoadProcess);
+	ready->Mapcar(CheckResident);
+    }
+
+    if (quiet && (n == 0))
+	printf("Checkpoint: no user programs left to save\n");
+    else if (quiet && !allLoaded)
+	printf("Checkpoint: not enough memory to load every page\n");
+    else if (quiet) {
+	fd = checkpointFd = OpenForWrite(checkpointFile);
+	header.magic = CheckpointMagic;
+	header.pageSize = PageSize;
+	header.numPhysPages = NumPhysPages;
+	header.numRegs = NumTotalRegs;
+	header.numThreads = n;
+	header.memoryOffset = 0;	// (we don't know yet; see below)
+	header.stats = *stats;
+	WriteFile(fd, (char *) &header, sizeof(header));
+	ready->Mapcar(WriteProcess);
+
+	header.memoryOffset = divRoundUp(Tell(fd), CheckpointAlign)
+					* CheckpointAlign;
+	while (Tell(fd) < header.memoryOffset)
+	    WriteFile(fd, &zero, 1);
+	WriteFile(fd, machine->mainMemory, MemorySize);
+	Lseek(fd, 0, 0);
+	WriteFile(fd, (char *) &header, sizeof(header));
+	Close(fd);
+	printf("Checkpoint: %d threads written to %s at tick %d\n", n,
+			checkpointFile, stats->totalTicks);
+    } else
+	DEBUG('t', "Checkpoint: not every thread is in user mode; will retry\n");
+
+    while (!ready->IsEmpty())
+	scheduler->ReadyToRun((Thread *) ready->Remove());
+    delete ready;
+    (void) interrupt->SetLevel(oldLevel);
+    return quiet;
+}
+
+//----------------------------------------------------------------------
+// CheckpointThreadRoot
+// 	The checkpoint thread: wait until the checkpoint is due, and
+//	write it, as soon as the user threads let us.
+//----------------------------------------------------------------------
+
+static void
+CheckpointThreadRoot(int arg)
+{
+    int tries;
+
+    for (tries = 0; tries < MaxCheckpointRetries; tries++) {
+	checkpointDue->P();
+	if (TakeCheckpoint())
+	    return;
+	interrupt->Schedule(CheckpointInterrupt, 0, CheckpointRetryTicks,
+				TimerInt);
+    }
+    printf("Checkpoint: gave up; some thread never left the kernel\n");
+}
+
+//----------------------------------------------------------------------
+// ScheduleCheckpoint
+// 	Arrange for a checkpoint to be written to "fileName" when
+//	simulated time reaches "when" (or as soon as possible after).
+//	Called from Initialize, for "-checkpoint".
+//----------------------------------------------------------------------
+
+void
+ScheduleCheckpoint(const char *fileName, int when)
+{
+    Thread *thread = new Thread("checkpoint");
+
+    checkpointFile = fileName;
+    checkpointDue = new Semaphore("checkpoint due", 0);
+    thread->Fork(CheckpointThreadRoot, 0);
+    interrupt->Schedule(CheckpointInterrupt, 0,
+			max(when - stats->totalTicks, 1), TimerInt);
+}
+
+//----------------------------------------------------------------------
+// ResumeProcess
+// 	The first thing a restored thread does: jump back into its
+//	user program, exactly where it left off.
+//----------------------------------------------------------------------
+
+static void
+ResumeProcess(int arg)
+{
+    currentThread->RestoreUserState();
+    currentThread->space->RestoreState();
+    machine->Run();
+}
+
+//----------------------------------------------------------------------
+// RestoreCheckpoint
+// 	Start Nachos from the checkpoint in "fileName": put main memory,
+//	the processes and simulated time back the way they were, and
+//	make each thread ready to run, in the order they were in.
+//	The threads start running when the caller (main) finishes.
+//----------------------------------------------------------------------
+
+void
+RestoreCheckpoint(const char *fileName)
+{
+    int fd;
+    CheckpointHeader header;
+    CheckpointThread rec;
+    CheckpointChild child;
+    TranslationEntry *table;
+    bool *cow;
+    AddrSpace *space;
+    Thread *thread;
+    Thread **threads;
+    int *parents;
+    PCB *pcb, *exited;
+    char *name;
+    int i, j;
+
+#ifdef FILESYS
+    printf("Can't restore a checkpoint over the Nachos file system\n");
+    return;
+#endif
+    fd = OpenForReadWrite(fileName, FALSE);
+    if (fd < 0) {
+	printf("Unable to open checkpoint %s\n", fileName);
+	return;
+    }
+    if ((ReadPartial(fd, (char *) &header, sizeof(header)) != sizeof(header))
+	    || (header.magic != CheckpointMagic)
+	    || (header.pageSize != PageSize)
+	    || (header.numPhysPages != NumPhysPages)
+	    || (header.numRegs != NumTotalRegs)) {
+	printf("%s is not a checkpoint of this machine\n", fileName);
+	Close(fd);
+	return;
+    }
+    *stats = header.stats;
+
+    threads = new Thread *[header.numThreads];
+    parents = new int[header.numThreads];
+    for (i = 0; i < header.numThreads; i++) {
+	Read(fd, (char *) &rec, sizeof(rec));
+	table = new TranslationEntry[rec.numPages];
+	Read(fd, (char *) table, rec.numPages * sizeof(TranslationEntry));
+	cow = new bool[rec.numPages];
+	Read(fd, (char *) cow, rec.numPages * sizeof(bool));
+	for (j = 0; j < rec.numPages; j++)
+	    if (table[j].valid)
+		mm->MarkPage(table[j].physicalPage);	// (shared ones twice)
+	space = new AddrSpace(table, cow, rec.numPages);
+
+	name = new char[NameLength];
+	strncpy(name, rec.name, NameLength);
+	name[NameLength - 1] = '\0';
+	thread = threads[i] = new Thread(name);
+	thread->space = space;
+	for (j = 0; j < NumTotalRegs; j++)
+	    machine->WriteRegister(j, rec.registers[j]);
+	thread->SaveUserState();
+
+	parents[i] = rec.parentPid;
+	pcb = NULL;
+	if ((rec.pid >= 0) && (pcbManager != NULL)) {
+	    pcb = pcbManager->AllocatePCB(rec.pid);
+	    pcb->thread = thread;
+	    pcb->exitStatus = rec.exitStatus;
+	    space->pcb = pcb;
+	}
+	for (j = 0; j < rec.numExited; j++) {
+	    Read(fd, (char *) &child, sizeof(child));
+	    if (pcb == NULL)
+		continue;
+	    exited = pcbManager->AllocatePCB(child.pid);
+	    exited->exitStatus = child.exitStatus;
+	    exited->parent = pcb;
+	    pcb->AddChild(exited);
+	}
+    }
+
+    // Now that every PCB exists, link the live ones to their parents.
+    for (i = 0; i < header.numThreads; i++) {
+	pcb = threads[i]->space->pcb;
+	if ((pcb != NULL) && (parents[i] >= 0)) {
+	    pcb->parent = pcbManager->GetPCB(parents[i]);
+	    if (pcb->parent != NULL)
+		pcb->parent->AddChild(pcb);
+	}
+    }
+
+    Lseek(fd, header.memoryOffset, 0);
+    Read(fd, machine->mainMemory, MemorySize);
+    Close(fd);
+
+    for (i = 0; i < header.numThreads; i++)
+	threads[i]->Fork(ResumeProcess, 0);
+    delete [] threads;
+    delete [] parents;
+    printf("Restored %d threads from %s at tick %d\n", header.numThreads,
+		fileName, stats->totalTicks);
+}
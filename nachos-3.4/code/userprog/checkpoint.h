@@ -0,0 +1,40 @@
+// checkpoint.h
+//	Saving the state of every user program to a file, and starting
+//	Nachos back up from that file later on, instead of from scratch.
+//
+//	"-checkpoint <file> <ticks>" writes a checkpoint once simulated
+//	time reaches <ticks>, and carries on running; "-restore <file>"
+//	starts Nachos from the checkpoint instead of from "-x".
+//
+//	Kernel threads run on host stacks, which we can't save.  So a
+//	checkpoint is only taken when no thread has anything on its
+//	kernel stack that matters: every user thread is on the ready
+//	list, having been switched out between two user instructions
+//	(Thread::atUserBoundary).  Then each process is just its user
+//	registers, its page table and its PCB, plus main memory, and
+//	restoring it is just a matter of putting those back and jumping
+//	to user mode.  If the system isn't in such a state when the
+//	checkpoint is due, we try again a little later.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "copyright.h"
+
+#define CheckpointMagic		0x504b434e	// "NCKP", little-endian
+#define CheckpointRetryTicks	TimerTicks	// how long to wait before
+						// trying again
+#define MaxCheckpointRetries	1000		// then give up
+
+extern void ScheduleCheckpoint(const char *fileName, int when);
+					// write a checkpoint to "fileName"
+					// at simulated time "when"
+extern void RestoreCheckpoint(const char *fileName);
+					// load a checkpoint, and make its
+					// threads ready to run
+
+#endif // CHECKPOINT_H
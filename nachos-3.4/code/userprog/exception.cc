@@ -25,6 +25,12 @@
 #include "system.h"
 #include "syscall.h"
 #include "synch.h"
+#ifdef USE_TLB
+#include "tlb.h"
+#endif
+#ifdef VM
+#include "loadcontrol.h"
+#endif
 
 //----------------------------------------------------------------------
 // ExceptionHandler
@@ -53,24 +59,25 @@
 void doExit(int status) {
 
     // Manage PCB memory As a parent process
+    // (the first process, started by StartProcess, has no PCB)
     PCB* pcb = currentThread->space->pcb;
     //save currentthread pid for later 
-    int pid = pcb->pid;
+    int pid = (pcb != NULL) ? pcb->pid : -1;
 
     printf("System Call: [%d] invoked [Exit]\n", pid);
     printf ("Process [%d] exits with [%d]\n", pid, status);
 
-    currentThread->space->pcb->exitStatus = status;
-    //exit status
-    pcb->exitStatus = status;
+    if (pcb != NULL) {
+        //exit status
+        pcb->exitStatus = status;
 
+        // Delete exited children and set parent null for non-exited ones
+        pcb->DeleteExitedChildrenSetParentNull();
 
-    // Delete exited children and set parent null for non-exited ones
-    pcb->DeleteExitedChildrenSetParentNull();
-
-    // Manage PCB memory As a child process
-    if(pcb->parent == NULL) {
-        pcbManager->DeallocatePCB(pcb);
+        // Manage PCB memory As a child process
+        if(pcb->parent == NULL) {
+            pcbManager->DeallocatePCB(pcb);
+        }
     }
 
     // Delete address space only after use is completed
@@ -95,6 +102,9 @@ void incrementPC() {
 
 void childFunction(int pid) {
 
+    // Once running, the child has kernel state of its own
+    currentThread->atUserBoundary = FALSE;
+
     // 1. Restore the state of registers
     currentThread->RestoreUserState();
 
@@ -119,15 +129,8 @@ int doFork(int functionAddr) {
             return -1;
         }
 
-    // 1. Check if sufficient memory exists to create new process
-    if(currentThread->space->GetNumPages() <= mm->GetFreePageCount())
-    {
-    // if check fails, return -1
-        printf("Not Enough Memory for child process %d\n", pcb->pid);
-        
-        //deallocate
-        pcbManager->DeallocatePCB(pcb);
-    }
+    // 1. No memory check: the child shares the parent's frames
+    // copy-on-write, so it needs none of its own yet
     // 2. SaveUserState for the parent thread
     currentThread->SaveUserState();
 
@@ -138,6 +141,7 @@ int doFork(int functionAddr) {
     if(childAddrSpace->valid==false)
     {
         printf("Couldnt Create the address space\n");
+        pcbManager->DeallocatePCB(pcb);
 
         return -1;
     }
@@ -168,6 +172,9 @@ int doFork(int functionAddr) {
     machine->WriteRegister(PrevPCReg, functionAddr -4);
     machine->WriteRegister(NextPCReg, functionAddr +4);
     childThread->SaveUserState();
+    // Until it runs, the child is nothing but its user registers
+    // and address space, so it can be checkpointed (checkpoint.cc)
+    childThread->atUserBoundary = TRUE;
 
     // 7. Restore register state of parent user-level process
     currentThread->RestoreUserState();
@@ -205,8 +212,8 @@ int doExec(char* filename) {
     // 3. Create new address space
     space = new AddrSpace(executable);
 
-    // 4.     delete executable;			// close file
-    delete executable;
+    // 4. The address space closes the file once it is done loading
+    // pages from it
     // 5. Check if Addrspace creation was successful
     if(space->valid != true) 
     {
@@ -216,6 +223,7 @@ int doExec(char* filename) {
 
     // 6. Set the PCB for the new addrspace - reused from deleted address space
     space->pcb = pcb;
+    space->StartProfile(filename);
 
     // 7. Set the addrspace for currentThread
     currentThread->space = space;
@@ -318,13 +326,19 @@ void doYield() {
 
 
 // This implementation is correct!
-// perform MMU translation to access physical memory
+// perform MMU translation to access physical memory; returns NULL if
+// the string runs off the address space, or out of memory
 char* readString(int virtualAddr) {
     char* str = new char[256];  // Allocate memory for the string
     int i = 0;
 
     while (i < 255) {  // Avoid buffer overflows
-        unsigned int physicalAddr = currentThread->space->Translate(virtualAddr);
+        unsigned int physicalAddr;
+
+        if (!currentThread->space->Translate(virtualAddr, &physicalAddr)) {
+            delete [] str;
+            return NULL;
+        }
 
         // Read from main memory using translated physical address
         str[i] = machine->mainMemory[physicalAddr];
@@ -351,8 +365,51 @@ ExceptionHandler(ExceptionType which)
 {
     int type = machine->ReadRegister(2);
 
+#ifdef USE_TLB
+    if ((which == PageFaultException)
+            && tlbManager->Refill(machine->ReadRegister(BadVAddrReg)))
+        return;                         // just a TLB miss; try again
+#endif
+    if (which == PageFaultException) {
+        int badVAddr = machine->ReadRegister(BadVAddrReg);
+
+#ifdef VM
+        loadControl->Fault(currentThread->space);   // (we may wait here)
+#endif
+        if (currentThread->space->PageIn(badVAddr)) {
+            currentThread->space->ReadAhead(badVAddr);
+            return;                     // first touch; try again
+        }
+        if ((unsigned) badVAddr >> PageShift
+                < currentThread->space->GetNumPages()) {
+            PCB *pcb = currentThread->space->pcb;
+
+            printf("Process [%d] is out of memory\n",
+                (pcb != NULL) ? pcb->pid : -1);
+            doExit(-1);
+        }
+    }
+    if (which == ReadOnlyException) {
+        int badVAddr = machine->ReadRegister(BadVAddrReg);
+        PCB *pcb = currentThread->space->pcb;  // (NULL for the first one)
+
+        if (currentThread->space->CopyOnWrite(badVAddr))
+            return;                     // first write; try again
+        if (currentThread->space->IsCopyOnWrite(badVAddr)) {
+            printf("Process [%d] is out of memory\n",
+                (pcb != NULL) ? pcb->pid : -1);
+            doExit(-1);
+        }
+        printf("Process [%d] wrote to read-only address %d\n",
+            (pcb != NULL) ? pcb->pid : -1, badVAddr);
+        doExit(-1);
+    }
+
     if ((which == SyscallException) && (type == SC_Halt)) {
 	DEBUG('a', "Shutdown, initiated by user program.\n");
+#ifdef USE_TLB
+        tlbManager->Account();          // so the statistics are complete
+#endif
    	interrupt->Halt();
     } else  if ((which == SyscallException) && (type == SC_Exit)) {
         // Implement Exit system call
@@ -364,7 +421,7 @@ ExceptionHandler(ExceptionType which)
     } else if ((which == SyscallException) && (type == SC_Exec)) {
         int virtAddr = machine->ReadRegister(4);
         char* fileName = readString(virtAddr);
-        int ret = doExec(fileName);
+        int ret = (fileName != NULL) ? doExec(fileName) : -1;
         machine->WriteRegister(2, ret);
         incrementPC();
     } else if ((which == SyscallException) && (type == SC_Join)) {
@@ -381,7 +438,8 @@ ExceptionHandler(ExceptionType which)
     } else if((which == SyscallException) && (type == SC_Create)) {
         int virtAddr = machine->ReadRegister(4);
         char* fileName = readString(virtAddr);
-        doCreate(fileName);
+        if (fileName != NULL)
+            doCreate(fileName);
         incrementPC();
     } else {
 	printf("Unexpected user mode exception %d %d\n", which, type);
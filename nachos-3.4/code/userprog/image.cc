@@ -0,0 +1,309 @@
+// image.cc
+//	Routines to load the pages of a user program from its NOFF file,
+//	on demand.  See image.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "memorymanager.h"
+#include "image.h"
+#ifdef VM
+#include "frametable.h"
+#endif
+#ifdef HOST_SPARC
+#include <strings.h>
+#endif
+
+static ProgramImage *images = NULL;	// every image we have
+static int imageBytes = 0;		// how much they have read in
+static int useClock = 0;		// counts Releases, for LRU
+
+//----------------------------------------------------------------------
+// SwapHeader
+// 	Do little endian to big endian conversion on the bytes in the
+//	object file header, in case the file was generated on a little
+//	endian machine, and we're now running on a big endian machine.
+//----------------------------------------------------------------------
+
+static void
+SwapHeader (NoffHeader *noffH)
+{
+	noffH->noffMagic = WordToHost(noffH->noffMagic);
+	noffH->code.size = WordToHost(noffH->code.size);
+	noffH->code.virtualAddr = WordToHost(noffH->code.virtualAddr);
+	noffH->code.inFileAddr = WordToHost(noffH->code.inFileAddr);
+	noffH->initData.size = WordToHost(noffH->initData.size);
+	noffH->initData.virtualAddr = WordToHost(noffH->initData.virtualAddr);
+	noffH->initData.inFileAddr = WordToHost(noffH->initData.inFileAddr);
+	noffH->uninitData.size = WordToHost(noffH->uninitData.size);
+	noffH->uninitData.virtualAddr = WordToHost(noffH->uninitData.virtualAddr);
+	noffH->uninitData.inFileAddr = WordToHost(noffH->uninitData.inFileAddr);
+}
+
+//----------------------------------------------------------------------
+// ProgramImage::Open
+// 	Return the image of the program in "executable", with a reference
+//	for the caller: the image we already have, if the file is the
+//	same and hasn't changed since we read it, else a new one.  Either
+//	way, "executable" is closed.
+//----------------------------------------------------------------------
+
+ProgramImage *
+ProgramImage::Open(OpenFile *executable)
+{
+    int sector = executable->HeaderSector();
+    ProgramImage **p, *image;
+
+    for (p = &images; (image = *p) != NULL; p = &image->next)
+	if (image->headerSector == sector)
+	    break;
+    if (image != NULL) {
+	if ((image->version == executable->Version())
+		&& (image->length == executable->Length())) {
+	    delete executable;
+	    image->Hold();
+	    stats->numImageHits++;
+	    DEBUG('a', "Program image %d found in the cache\n", sector);
+	    return image;
+	}
+	*p = image->next;		// out of date; whoever is still
+	image->cached = FALSE;		// running it can keep it
+	if (image->refs == 0)
+	    delete image;
+    }
+    image = new ProgramImage(executable);
+    if (image->valid) {
+	image->next = images;
+	images = image;
+	image->cached = TRUE;
+	Trim();
+    }
+    return image;
+}
+
+//----------------------------------------------------------------------
+// ProgramImage::ProgramImage
+// 	Read and check the header of a NOFF file, then read in its code
+//	and initialized data, each with a single read, at their places
+//	in the address space; the gaps between them are zero.  None of
+//	the code is in physical memory yet.  We're done with the file
+//	once this returns, so we close it.
+//
+//	"executable" is the file containing the object code
+//----------------------------------------------------------------------
+
+ProgramImage::ProgramImage(OpenFile *executable)
+{
+    Segment *segments[2] = { &noffH.code, &noffH.initData };
+    int i, end = 0;
+
+    headerSector = executable->HeaderSector();
+    version = executable->Version();
+    length = executable->Length();
+    refs = 1;
+    lastUsed = 0;
+    cached = FALSE;
+    next = NULL;
+
+    executable->ReadAt((char *)&noffH, sizeof(noffH), 0);
+    if ((noffH.noffMagic != NOFFMAGIC) &&
+		(WordToHost(noffH.noffMagic) == NOFFMAGIC))
+    	SwapHeader(&noffH);
+    valid = (noffH.noffMagic == NOFFMAGIC);
+
+    for (i = 0; valid && (i < 2); i++)
+	if (segments[i]->size > 0)
+	    end = max(end, segments[i]->virtualAddr + segments[i]->size);
+    numFilePages = divRoundUp(end, PageSize);
+    contents = new char[numFilePages * PageSize];
+    bzero(contents, numFilePages * PageSize);
+    for (i = 0; valid && (i < 2); i++)
+	if (segments[i]->size > 0)
+	    executable->ReadAt(contents + segments[i]->virtualAddr,
+			segments[i]->size, segments[i]->inFileAddr);
+    imageBytes += numFilePages * PageSize;
+    delete executable;
+    if (valid) {
+	stats->numImageLoads++;
+	DEBUG('a', "Program image %d read in, %d pages\n", headerSector,
+		numFilePages);
+    }
+
+    numTextPages = valid ? divRoundUp(noffH.code.virtualAddr
+					+ noffH.code.size, PageSize) : 0;
+    textFrames = new int[numTextPages];
+    for (i = 0; i < numTextPages; i++)
+	textFrames[i] = -1;
+}
+
+//----------------------------------------------------------------------
+// ProgramImage::~ProgramImage
+// 	Throw away what we read from the file, and let go of the code
+//	pages we were keeping.
+//----------------------------------------------------------------------
+
+ProgramImage::~ProgramImage()
+{
+    ProgramImage **p;
+
+    for (p = &images; cached && (*p != NULL); p = &(*p)->next)
+	if (*p == this) {
+	    *p = next;
+	    break;
+	}
+    for (int i = 0; i < numTextPages; i++)
+	if (textFrames[i] != -1)
+	    ForgetTextFrame(i);
+    delete [] textFrames;
+    imageBytes -= numFilePages * PageSize;
+    delete [] contents;
+}
+
+//----------------------------------------------------------------------
+// ProgramImage::Trim
+// 	While the images we have take up more than ImageCacheSize bytes,
+//	throw away the one that has been idle longest.  Images that are
+//	in use stay, whatever their size.
+//----------------------------------------------------------------------
+
+void
+ProgramImage::Trim()
+{
+    ProgramImage *image, *oldest;
+
+    while (imageBytes > ImageCacheSize) {
+	oldest = NULL;
+	for (image = images; image != NULL; image = image->next)
+	    if ((image->refs == 0) && ((oldest == NULL)
+			|| (image->lastUsed < oldest->lastUsed)))
+		oldest = image;
+	if (oldest == NULL)
+	    return;			// everything is in use
+	DEBUG('a', "Program image %d dropped from the cache\n",
+		oldest->headerSector);
+	delete oldest;
+    }
+}
+
+//----------------------------------------------------------------------
+// ProgramImage::IsText
+// 	Return TRUE if page "vpn" holds nothing but code, so that every
+//	address space running the program can share it, read-only.
+//	A page that is partly data can't be shared.
+//----------------------------------------------------------------------
+
+bool
+ProgramImage::IsText(int vpn)
+{
+    int start = vpn * PageSize, end = start + PageSize;
+    Segment *data[2] = { &noffH.initData, &noffH.uninitData };
+
+    if ((vpn >= numTextPages) || (start < noffH.code.virtualAddr)
+	    || (end > noffH.code.virtualAddr + noffH.code.size))
+	return FALSE;
+    for (int i = 0; i < 2; i++)
+	if ((data[i]->size > 0) && (start < data[i]->virtualAddr
+					+ data[i]->size)
+		&& (data[i]->virtualAddr < end))
+	    return FALSE;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// ProgramImage::SetTextFrame
+// 	Code page "vpn" has been loaded into "frame".  Keep a reference
+//	to the frame, so that later address spaces can map it too.
+//----------------------------------------------------------------------
+
+void
+ProgramImage::SetTextFrame(int vpn, int frame)
+{
+    ASSERT(textFrames[vpn] == -1);
+    textFrames[vpn] = frame;
+    mm->Share(frame);
+#ifdef VM
+    frameTable->SetText(frame, this, vpn);
+#endif
+}
+
+//----------------------------------------------------------------------
+// ProgramImage::ForgetTextFrame
+// 	Let go of the frame holding code page "vpn": the image is going
+//	away, or (with VM) the frame is being evicted.
+//----------------------------------------------------------------------
+
+void
+ProgramImage::ForgetTextFrame(int vpn)
+{
+    int frame = textFrames[vpn];
+
+    textFrames[vpn] = -1;
+#ifdef VM
+    frameTable->SetText(frame, NULL, 0);
+#endif
+    mm->DeallocatePage(frame);
+}
+
+//----------------------------------------------------------------------
+// ProgramImage::Release
+// 	An address space no longer needs to load pages from this file.
+//	If it was the last one, the frames of code go back to the free
+//	list, but we keep what we read from the file for the next time
+//	the program is run -- unless it is out of date, or there is no
+//	room for it.
+//----------------------------------------------------------------------
+
+void
+ProgramImage::Release()
+{
+    ASSERT(refs > 0);
+    if (--refs > 0)
+	return;
+    if (!cached) {
+	delete this;
+	return;
+    }
+    for (int i = 0; i < numTextPages; i++)
+	if (textFrames[i] != -1)
+	    ForgetTextFrame(i);
+    lastUsed = ++useClock;
+    Trim();
+}
+
+//----------------------------------------------------------------------
+// ProgramImage::Size
+// 	Return how much of the address space the program's code and
+//	data take up (the stack goes after them).
+//----------------------------------------------------------------------
+
+int
+ProgramImage::Size()
+{
+    return noffH.code.size + noffH.initData.size + noffH.uninitData.size;
+}
+
+//----------------------------------------------------------------------
+// ProgramImage::LoadPage
+// 	Fill in the contents of virtual page "vpn", as the program
+//	starts out: a copy of what we read from the file, or zeroes for
+//	uninitialized data and the stack.
+//
+//	Returns the number of bytes copied (0 for a page of zeroes).
+//
+//	"vpn" -- the virtual page to fill in
+//	"into" -- where in main memory to put it
+//----------------------------------------------------------------------
+
+int
+ProgramImage::LoadPage(int vpn, char *into)
+{
+    if (vpn >= numFilePages) {
+	bzero(into, PageSize);
+	return 0;
+    }
+    bcopy(contents + vpn * PageSize, into, PageSize);
+    return PageSize;
+}
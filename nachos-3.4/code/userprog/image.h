@@ -0,0 +1,90 @@
+// image.h
+//	Data structures for a user program's executable (NOFF) file,
+//	from which its address space is loaded a page at a time, as the
+//	program touches each page for the first time.
+//
+//	Every page of the address space is backed either by the file
+//	(code and initialized data) or by nothing at all (uninitialized
+//	data and the stack), in which case it starts out zeroed.  The
+//	segment offsets in the NOFF header are all we need to tell which,
+//	and where in the file to read it from.
+//
+//	Every address space running the same program -- the same file,
+//	identified by its header sector -- shares one image.  Pages that
+//	hold nothing but code are shared as well: the first address space
+//	to touch one loads it into a frame, which the image keeps, and the
+//	rest just map that frame, read-only, until the last of them is
+//	gone.
+//
+//	The image reads the code and initialized data from the file once,
+//	with one read per segment, and keeps them in kernel memory, laid
+//	out page by page as in the address space; a page fault is then
+//	just a copy.  Once no address space is using an image, we keep it
+//	anyway, in case the program is run again -- as programs run from
+//	the shell or a batch script usually are -- so that Exec needn't
+//	read the file at all.  The least recently used of these idle
+//	images are thrown away when they take up more than ImageCacheSize
+//	bytes between them, and so is any image whose file has since
+//	been changed.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include "copyright.h"
+#include "filesys.h"
+#include "noff.h"
+
+#define ImageCacheSize	(64 * 1024)	// keep at most this many bytes of
+					// programs no one is running
+
+class ProgramImage {
+  public:
+    static ProgramImage *Open(OpenFile *executable);
+					// Return the image of "executable",
+					// which we close when we're done
+    ~ProgramImage();
+
+    bool IsValid() { return valid; }	// FALSE if it isn't a NOFF file
+    int Size();				// # of bytes of code and data
+    NoffHeader *Header() { return &noffH; }
+
+    void Hold() { refs++; }		// another address space uses us
+    void Release();			// ... and is done
+
+    int LoadPage(int vpn, char *into);	// Fill in page "vpn" at "into";
+					// return # of bytes copied
+
+    bool IsText(int vpn);		// Is page "vpn" all code?
+    bool IsZero(int vpn) { return vpn >= numFilePages; }
+					// ... or all zeroes, to start with?
+    int TextFrame(int vpn) { return textFrames[vpn]; }
+					// the frame holding it, or -1
+    void SetTextFrame(int vpn, int frame);
+					// "frame" holds it now
+    void ForgetTextFrame(int vpn);	// ... and no longer does
+
+  private:
+    ProgramImage(OpenFile *executable);	// Read in "executable"
+
+    static void Trim();			// Keep the idle images within
+					// ImageCacheSize
+
+    int headerSector;			// which file it is,
+    int version, length;		// and what was in it when read
+    NoffHeader noffH;			// segment sizes and offsets
+    bool valid;
+    char *contents;			// pages 0 .. numFilePages-1, as
+    int numFilePages;			// loaded from the file
+    int refs;				// # of address spaces using us
+    int lastUsed;			// when the last one let go of us
+    bool cached;			// still on the list of images?
+    int numTextPages;			// pages 0 .. numTextPages-1 may be
+    int *textFrames;			// code; the frame each is in, or -1
+    ProgramImage *next;			// next image in use
+};
+
+#endif // IMAGE_H
@@ -1,43 +1,288 @@
 #include "memorymanager.h"
 #include "machine.h"
+#include "system.h"
 
 MemoryManager::MemoryManager() {
 
     //mem allocated at the granularity of a page
-    bitmap = new BitMap(NumPhysPages);
+    refs = new int[NumPhysPages];
+    blockOrder = new int[NumPhysPages];
+    nextFree = new int[NumPhysPages];
+    prevFree = new int[NumPhysPages];
+    pool = new int[NumPhysPages];
+    poolIndex = new int[NumPhysPages];
+    for (int i = 0; i < NumPhysPages; i++) {
+        refs[i] = 0;
+        blockOrder[i] = -1;
+        poolIndex[i] = -1;
+    }
+    poolSize = 0;
+
+    //enough orders for one block to cover all of memory
+    for (numOrders = 1; (1 << (numOrders - 1)) < NumPhysPages; numOrders++)
+        ;
+    freeList = new int[numOrders];
+    for (int k = 0; k < numOrders; k++)
+        freeList[k] = -1;
+
+    //carve memory into the biggest aligned blocks that fit (if
+    //NumPhysPages isn't a power of 2, there is more than one)
+    int frame = 0;
+    while (frame < NumPhysPages) {
+        int k = numOrders - 1;
+        while ((frame & ((1 << k) - 1)) || (frame + (1 << k) > NumPhysPages))
+            k--;
+        Push(frame, k);
+        frame += 1 << k;
+    }
+    freeCount = NumPhysPages;
+    zeroFrame = -1;
 }
 
 
 MemoryManager::~MemoryManager() {
 
-    delete bitmap;
+    delete [] refs;
+    delete [] blockOrder;
+    delete [] nextFree;
+    delete [] prevFree;
+    delete [] freeList;
+    delete [] pool;
+    delete [] poolIndex;
+
+}
+
+//puts the free block of 2^order frames starting at "frame" at the
+//head of its free list
+void MemoryManager::Push(int frame, int order) {
+
+    blockOrder[frame] = order;
+    prevFree[frame] = -1;
+    nextFree[frame] = freeList[order];
+    if (freeList[order] != -1)
+        prevFree[freeList[order]] = frame;
+    freeList[order] = frame;
+}
+
+//takes the free block starting at "frame" off its free list
+void MemoryManager::Remove(int frame) {
+
+    int order = blockOrder[frame];
+
+    ASSERT(order != -1);
+    if (prevFree[frame] != -1)
+        nextFree[prevFree[frame]] = nextFree[frame];
+    else
+        freeList[order] = nextFree[frame];
+    if (nextFree[frame] != -1)
+        prevFree[nextFree[frame]] = prevFree[frame];
+    blockOrder[frame] = -1;
+}
+
+//takes a block of 2^order frames off the free lists, splitting a
+//bigger one (and giving back the halves we don't need) if there is
+//none that size; sets "from" to the order of the block we split.
+//returns the block's first frame, or -1 if there is none that big
+int MemoryManager::Split(int order, int *from) {
 
+    int k, frame;
+
+    if (order >= numOrders)
+        return -1;
+    for (k = order; (k < numOrders) && (freeList[k] == -1); k++)
+        ;
+    if (k == numOrders)
+        return -1;
+    frame = freeList[k];
+    Remove(frame);
+    *from = k;
+    while (k > order) {
+        k--;
+        Push(frame + (1 << k), k);
+    }
+    return frame;
 }
 
-//returns which frame # is available to use 
+//takes the most recently zeroed frame out of the pool
+int MemoryManager::PopPool() {
+
+    int frame = pool[poolSize - 1];
+
+    RemoveFromPool(frame);
+    return frame;
+}
+
+//takes "frame" out of the pool of zeroed frames
+void MemoryManager::RemoveFromPool(int frame) {
+
+    int i = poolIndex[frame];
+
+    ASSERT(i != -1);
+    pool[i] = pool[--poolSize];
+    poolIndex[pool[i]] = i;
+    poolIndex[frame] = -1;
+}
+
+//a free frame (off the free lists) is now in use, with one reference
+void MemoryManager::Claim(int frame) {
+
+    // whatever the frame held before, any decoded instructions
+    // from it are stale now that it is being handed out again
+    refs[frame] = 1;
+    machine->InvalidateDecodeCache(frame);
+    freeCount--;
+}
+
+//returns which frame # is available to use; leaves the zeroed ones
+//for those who need them, unless there are no others
 int MemoryManager::AllocatePage() {
 
-    int page = bitmap->Find();
-    return page;
+    int frame = AllocateRun(0);
+
+    if ((frame == -1) && (poolSize > 0)) {
+        frame = PopPool();
+        Claim(frame);
+    }
+    return frame;
 }
 
-int MemoryManager::DeallocatePage(int which) {
+//returns a frame that is all zeroes: from the pool, if the idle loop
+//has zeroed one for us, else we zero one now
+int MemoryManager::AllocateZeroedPage() {
 
-    if(bitmap->Test(which) == false) return -1;
-    else {
+    int frame;
 
-        bitmap->Clear(which);
+    if (poolSize > 0) {
+        frame = PopPool();
+        Claim(frame);
+        stats->numZeroPoolHits++;
+        return frame;
+    }
+    frame = AllocateRun(0);
+    if (frame != -1) {
+        bzero(&machine->mainMemory[frame * PageSize], PageSize);
+        stats->numZeroPoolMisses++;
+    }
+    return frame;
+}
 
-        return 0;
+//returns the first of 2^order contiguous frames, each with one
+//reference of its own (so each is freed by DeallocatePage as usual),
+//or -1 if there is no free block that big.  for a run of more than
+//one frame, zeroed frames go back on the free lists if that is what
+//it takes; a single frame comes out of the pool instead (see
+//AllocatePage), so one allocation doesn't undo the idle loop's work
+int MemoryManager::AllocateRun(int order) {
+
+    int from, frame = Split(order, &from);
+
+    if ((frame == -1) && (order > 0) && (poolSize > 0)) {
+        while (poolSize > 0)
+            Free(PopPool());
+        frame = Split(order, &from);
+    }
+    if (frame == -1)
+        return -1;
+    stats->numFrameAllocs[min(from - order, FrameAllocBuckets - 1)]++;
+    for (int i = frame; i < frame + (1 << order); i++)
+        Claim(i);
+    return frame;
+}
+
+//zeroes free frames until ZeroPoolSize of them are zeroed; called
+//when the CPU would otherwise sit idle, so it costs nobody anything
+void MemoryManager::ZeroIdleFrames() {
+
+    int from, frame;
+
+    while (poolSize < ZeroPoolSize) {
+        frame = Split(0, &from);
+        if (frame == -1)
+            return;
+        bzero(&machine->mainMemory[frame * PageSize], PageSize);
+        poolIndex[frame] = poolSize;
+        pool[poolSize++] = frame;
+        stats->numFramesZeroed++;
+    }
+}
+
+//marks frame "which" in use, when restoring a checkpoint puts a
+//process's pages back where they were; if another process's page
+//table already claimed it, the two share it
+void MemoryManager::MarkPage(int which) {
+
+    int k, head;
+
+    if (refs[which] > 0) {
+        refs[which]++;
+        return;
+    }
+    if (poolIndex[which] != -1) {
+        RemoveFromPool(which);
+        Claim(which);
+        return;
     }
 
+    //find the free block it is in, and split it down around it
+    for (k = 0; k < numOrders; k++) {
+        head = which & ~((1 << k) - 1);
+        if (blockOrder[head] == k)
+            break;
+    }
+    ASSERT(k < numOrders);
+    Remove(head);
+    while (k > 0) {
+        k--;
+        if (which < head + (1 << k))
+            Push(head + (1 << k), k);
+        else {
+            Push(head, k);
+            head += 1 << k;
+        }
+    }
+    Claim(which);
 }
 
+//frame "which" has no references left; merges it with its buddy,
+//and the result with its buddy, for as long as the buddy is free
+//(the caller counts it as free, if it wasn't already)
+void MemoryManager::Free(int which) {
 
-unsigned int MemoryManager::GetFreePageCount() {
+    int k = 0, buddy;
 
-    return bitmap->NumClear();
+    while (k < numOrders - 1) {
+        buddy = which ^ (1 << k);
+        if ((buddy >= NumPhysPages) || (blockOrder[buddy] != k))
+            break;
+        Remove(buddy);
+        which = min(which, buddy);
+        k++;
+    }
+    Push(which, k);
+}
 
+//returns the frame of zeroes, making it the first time; we keep a
+//reference to it ourselves, so it is never freed, and nobody may
+//write to it (every page mapping it is read-only, copy-on-write)
+int MemoryManager::ZeroFrame() {
+
+    if (zeroFrame == -1)
+        zeroFrame = AllocateZeroedPage();
+    return zeroFrame;
 }
 
+//drops a reference to frame "which"; it is free once nobody maps it
+int MemoryManager::DeallocatePage(int which) {
 
+    if(refs[which] == 0) return -1;
+    else {
+
+        if (--refs[which] == 0) {
+            Free(which);
+            freeCount++;
+        }
+
+        return 0;
+    }
+
+}
@@ -1,7 +1,22 @@
 #ifndef MEMORY_H
 #define MEMORY_H
 
-#include "bitmap.h"
+//physical frames are handed out by a buddy allocator: every free
+//frame is part of exactly one free block of 2^k frames, aligned on
+//a multiple of 2^k, and there is a free list of blocks for each k.
+//a single frame comes off the list for k = 0 if it has anything on
+//it (which is the usual case), else from splitting the smallest
+//bigger block; a freed frame merges with its buddy, and so on up,
+//so runs of contiguous frames can still be had.  the number of free
+//frames is kept as we go, not counted.
+//
+//a few free frames are also kept apart, already zeroed, for pages
+//that have to start out as zeroes: when there is nothing to run,
+//the idle loop zeroes free frames (up to ZeroPoolSize of them) so
+//that a zero-fill fault needn't.  they are still free frames, and
+//anybody gets one if there is nothing else left.
+
+#define ZeroPoolSize 8			// zeroed frames to keep ready
 
 class MemoryManager {
 
@@ -10,14 +25,57 @@ class MemoryManager {
         ~MemoryManager();
 
         int AllocatePage();
-        int DeallocatePage(int which);
-        unsigned int GetFreePageCount();
+        int AllocateZeroedPage();	// ... one that is all zeroes
+        int AllocateRun(int order);	// 2^order contiguous frames;
+					// returns the first, or -1
+        void MarkPage(int which);	// allocate a particular frame
+        int DeallocatePage(int which);	// drop one reference to it
+        unsigned int GetFreePageCount() { return freeCount; }
+
+        void Share(int which) { refs[which]++; }
+					// one more page table maps "which"
+        int RefCount(int which) { return refs[which]; }
+
+        int ZeroFrame();		// the frame of zeroes every page
+					// that is still all zeroes maps;
+					// -1 if there isn't one yet and
+					// no frame to make it with
+        bool IsZeroFrame(int which) { return which == zeroFrame; }
+
+        void ZeroIdleFrames();		// nothing else to do; fill up
+					// the pool of zeroed frames
 
     private:
-        BitMap *bitmap;
+        int *refs;			// # of pages mapping each frame;
+					// it is free when this drops to 0
+        int freeCount;			// # of frames with no references
+        int zeroFrame;			// -1 until first asked for
+
+        int numOrders;			// blocks are 2^0 .. 2^(numOrders-1)
+        int *freeList;			// first free block of each order
+        int *blockOrder;		// for the first frame of a free
+					// block, its order; else -1
+        int *nextFree, *prevFree;	// the free lists, linked through
+					// each block's first frame
+
+        int *pool;			// zeroed frames, not on the free
+        int poolSize;			// lists; how many there are,
+        int *poolIndex;			// and where each frame is in
+					// "pool" (-1 if it isn't)
+
+        void Push(int frame, int order);// put a free block on its list
+        void Remove(int frame);		// take it off again
+        void Free(int which);		// "which" is free; merge it
+        int Split(int order, int *from);// take a block of 2^order frames
+					// off the free lists
+        int PopPool();			// take a zeroed frame
+        void RemoveFromPool(int frame);
+        void Claim(int frame);		// "frame" is in use now
 
 };
 
 
 
-#endif // MEMORY_H
\ No newline at end of file
+extern MemoryManager *mm;
+
+#endif // MEMORY_H
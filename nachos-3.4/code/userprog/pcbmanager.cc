@@ -40,6 +40,19 @@ PCB* PCBManager::AllocatePCB() {
 }
 
 
+// Allocate the PCB for a particular pid, when restoring a checkpoint.
+PCB* PCBManager::AllocatePCB(int pid) {
+
+    ASSERT(!bitmap->Test(pid));
+    bitmap->Mark(pid);
+
+    pcbs[pid] = new PCB(pid);
+
+    return pcbs[pid];
+
+}
+
+
 int PCBManager::DeallocatePCB(PCB* pcb) {
 
     // Check is pcb is valid -- check pcbs for pcb->pid
@@ -15,6 +15,7 @@ class PCBManager {
         ~PCBManager();
 
         PCB* AllocatePCB();
+        PCB* AllocatePCB(int pid);	// with a particular pid
         int DeallocatePCB(PCB* pcb);
         PCB* GetPCB(int pid);
 
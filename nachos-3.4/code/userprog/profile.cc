@@ -0,0 +1,523 @@
+// profile.cc
+//	Routines to profile user programs: count instructions and
+//	procedure calls as the program runs, and print the results,
+//	named from the program's symbol table, when Nachos halts.
+//	See profile.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "profile.h"
+#include "mipssim.h"
+#include "coff.h"
+#include "noff.h"
+
+bool profileUserPrograms = FALSE;
+static List *profiles = NULL;		// every profile ever made, to
+					// print at Halt
+
+#define NumHottest	10		// # of instructions to list
+
+// A procedure from the program's symbol table.
+class ProfileSymbol {
+  public:
+    int addr;			// its first instruction
+    char *name;
+    int self;			// instructions run in it
+};
+
+//----------------------------------------------------------------------
+// UserProfile::UserProfile
+// 	Start profiling a user program, with every count zero.
+//
+//	"programName" -- the program's NOFF file (the symbol table is in
+//		"programName".coff)
+//	"size" -- the size of the address space, in bytes
+//----------------------------------------------------------------------
+
+UserProfile::UserProfile(const char *programName, int size)
+{
+    int i;
+
+    fileName = new char[strlen(programName) + 1];
+    strcpy(fileName, programName);
+    pid = -1;
+    numWords = size / 4;
+    counts = new int[numWords + 1];
+    for (i = 0; i <= numWords; i++)
+	counts[i] = 0;
+    total = 0;
+    branchPC = -1;
+
+    arcsSize = procsSize = 64;
+    numArcs = numProcs = 0;
+    arcs = new ProfileArc[arcsSize];
+    procs = new ProfileArc[procsSize];
+    for (i = 0; i < arcsSize; i++)
+	arcs[i].count = procs[i].count = -1;	// -1 => empty slot
+
+    stackSize = 64;
+    depth = 0;
+    stack = new ProfileFrame[stackSize];
+
+    if (profiles == NULL)
+	profiles = new List;
+    profiles->Append(this);
+}
+
+//----------------------------------------------------------------------
+// UserProfile::~UserProfile
+// 	De-allocate a profile.
+//----------------------------------------------------------------------
+
+UserProfile::~UserProfile()
+{
+    delete [] fileName;
+    delete [] counts;
+    delete [] arcs;
+    delete [] procs;
+    delete [] stack;
+}
+
+//----------------------------------------------------------------------
+// UserProfile::Lookup
+// 	Find the entry for (site, callee) in a hash table of ProfileArcs,
+//	adding one (with zero counts) if there is none.  The table is
+//	doubled when it gets half full.
+//
+//	"table", "size", "num" -- the table, its size, and # of entries
+//----------------------------------------------------------------------
+
+ProfileArc *
+UserProfile::Lookup(ProfileArc **table, int *size, int *num, int site,
+			int callee)
+{
+    ProfileArc *t = *table;
+    int i;
+
+    if (2 * (*num + 1) > *size) {		// time to grow
+	ProfileArc *old = t;
+	int oldSize = *size;
+
+	*size *= 2;
+	t = *table = new ProfileArc[*size];
+	for (i = 0; i < *size; i++)
+	    t[i].count = -1;
+	*num = 0;
+	for (i = 0; i < oldSize; i++)
+	    if (old[i].count != -1)
+		*Lookup(table, size, num, old[i].site, old[i].callee) = old[i];
+	delete [] old;
+    }
+    i = ((unsigned) (site * 31 + callee) / 4) & (*size - 1);
+    while (t[i].count != -1) {
+	if ((t[i].site == site) && (t[i].callee == callee))
+	    return &t[i];
+	i = (i + 1) & (*size - 1);
+    }
+    (*num)++;
+    t[i].site = site;
+    t[i].callee = callee;
+    t[i].count = t[i].inclusive = t[i].active = 0;
+    return &t[i];
+}
+
+//----------------------------------------------------------------------
+// UserProfile::Branch
+// 	Called by the simulator when a branch or jump has run.  We only
+//	know where it went once its delay slot has run too, which may be
+//	in another block: the branch may be the last word of a page, or
+//	the block may be cut short by the next interrupt.  So we hold on
+//	to the branch until DelaySlot is called.
+//
+//	"instr" -- the branch or jump
+//	"pc" -- its address
+//----------------------------------------------------------------------
+
+void
+UserProfile::Branch(Instruction *instr, int pc)
+{
+    branchPC = pc;
+    branchOp = instr->opCode;
+    branchReg = instr->rs;
+}
+
+//----------------------------------------------------------------------
+// UserProfile::DelaySlot
+// 	Called by the simulator when the delay slot of the last branch
+//	or jump has run, to keep track of procedure calls (jal, jalr,
+//	and the bgezal/bltzal branches, when taken) and returns (jr $31).
+//
+//	"pcAfter" -- where control went after the delay slot
+//----------------------------------------------------------------------
+
+void
+UserProfile::DelaySlot(int pcAfter)
+{
+    int pc = branchPC;
+
+    if (pc == -1)
+	return;
+    branchPC = -1;
+    switch (branchOp) {
+      case OP_JAL:
+      case OP_JALR:
+	Call(pc, pcAfter);
+	break;
+
+      case OP_BGEZAL:
+      case OP_BLTZAL:
+	if (pcAfter != pc + 8)		// taken
+	    Call(pc, pcAfter);
+	break;
+
+      case OP_JR:
+	if (branchReg == RetAddrReg)
+	    Return(pcAfter);
+	break;
+    }
+}
+
+//----------------------------------------------------------------------
+// UserProfile::Call
+// 	Count a procedure call, and push it on the shadow call stack.
+//----------------------------------------------------------------------
+
+void
+UserProfile::Call(int site, int callee)
+{
+    ProfileArc *proc;
+
+    Lookup(&arcs, &arcsSize, &numArcs, site, callee)->count++;
+    proc = Lookup(&procs, &procsSize, &numProcs, 0, callee);
+    proc->count++;
+    proc->active++;
+
+    if (depth == stackSize) {
+	ProfileFrame *old = stack;
+
+	stack = new ProfileFrame[stackSize * 2];
+	for (int i = 0; i < stackSize; i++)
+	    stack[i] = old[i];
+	stackSize *= 2;
+	delete [] old;
+    }
+    stack[depth].callee = callee;
+    stack[depth].returnAddr = site + 8;		// past the delay slot
+    stack[depth].start = total;
+    depth++;
+}
+
+//----------------------------------------------------------------------
+// UserProfile::Return
+// 	Pop the shadow call stack back to the call that returns to
+//	"returnAddr", charging each procedure popped for the instructions
+//	run since it was called.  A procedure that is still active
+//	further down the stack (it is recursive) is only charged when its
+//	outermost activation returns, so nothing is counted twice.
+//
+//	A return that matches no call (e.g., from main back to the
+//	startup code) is ignored.
+//----------------------------------------------------------------------
+
+void
+UserProfile::Return(int returnAddr)
+{
+    ProfileArc *proc;
+    int i;
+
+    for (i = depth - 1; i >= 0; i--)
+	if (stack[i].returnAddr == returnAddr)
+	    break;
+    if (i < 0)
+	return;
+    while (depth > i) {
+	depth--;
+	proc = Lookup(&procs, &procsSize, &numProcs, 0, stack[depth].callee);
+	if (--proc->active == 0)
+	    proc->inclusive += total - stack[depth].start;
+    }
+}
+
+//----------------------------------------------------------------------
+// ReadSymbols
+// 	Read the procedures out of the symbol table of "fileName".coff,
+//	sorted by address.
+//
+//	Returns the number of procedures found (0 if the file can't be
+//	read), and sets "*symsPtr" to an array of them.
+//----------------------------------------------------------------------
+
+static int
+ReadSymbols(const char *fileName, ProfileSymbol **symsPtr)
+{
+    char *coffName = new char[strlen(fileName) + sizeof(".coff")];
+    OpenFile *file;
+    struct filehdr fileH;
+    HDRR symH;
+    EXTR *ext;
+    char *strings;
+    ProfileSymbol *syms, sym;
+    int i, j, n = 0;
+
+    sprintf(coffName, "%s.coff", fileName);
+    file = fileSystem->Open(coffName);
+    delete [] coffName;
+    if (file == NULL)
+	return 0;
+    if ((file->ReadAt((char *) &fileH, sizeof(fileH), 0) != sizeof(fileH))
+	    || (fileH.f_magic != MIPSELMAGIC) || (fileH.f_symptr == 0)
+	    || (file->ReadAt((char *) &symH, sizeof(symH), fileH.f_symptr)
+			!= sizeof(symH))
+	    || (symH.magic != MAGIC_SYM)) {
+	delete file;
+	return 0;
+    }
+
+    ext = new EXTR[symH.iextMax];
+    strings = new char[symH.issExtMax + 1];
+    file->ReadAt((char *) ext, symH.iextMax * sizeof(EXTR), symH.cbExtOffset);
+    file->ReadAt(strings, symH.issExtMax, symH.cbSsExtOffset);
+    strings[symH.issExtMax] = '\0';
+    delete file;
+
+    syms = new ProfileSymbol[symH.iextMax];
+    for (i = 0; i < symH.iextMax; i++) {
+	SYMR *s = &ext[i].asym;
+
+	if (((s->st != stProc) && (s->st != stStaticProc))
+		|| (s->sc != scText) || (s->iss >= symH.issExtMax))
+	    continue;
+	sym.addr = s->value;
+	sym.name = new char[strlen(&strings[s->iss]) + 1];
+	strcpy(sym.name, &strings[s->iss]);
+	sym.self = 0;
+	for (j = n; (j > 0) && (syms[j - 1].addr > sym.addr); j--)
+	    syms[j] = syms[j - 1];		// insertion sort
+	syms[j] = sym;
+	n++;
+    }
+    delete [] ext;
+    delete [] strings;
+    *symsPtr = syms;
+    return n;
+}
+
+//----------------------------------------------------------------------
+// FindSymbol
+// 	Return the index of the procedure containing "addr", or -1.
+//----------------------------------------------------------------------
+
+static int
+FindSymbol(ProfileSymbol *syms, int numSyms, int addr)
+{
+    int lo = 0, hi = numSyms - 1, mid;
+
+    if ((numSyms == 0) || (addr < syms[0].addr))
+	return -1;
+    while (lo < hi) {			// last symbol at or before addr
+	mid = (lo + hi + 1) / 2;
+	if (syms[mid].addr <= addr)
+	    lo = mid;
+	else
+	    hi = mid - 1;
+    }
+    return lo;
+}
+
+//----------------------------------------------------------------------
+// PrintAddress
+// 	Print "addr" as procedure+offset, if we know the procedure.
+//----------------------------------------------------------------------
+
+static void
+PrintAddress(ProfileSymbol *syms, int numSyms, int addr)
+{
+    int i = FindSymbol(syms, numSyms, addr);
+
+    if (i < 0)
+	printf("0x%x", addr);
+    else if (syms[i].addr == addr)
+	printf("%s", syms[i].name);
+    else
+	printf("%s+0x%x", syms[i].name, addr - syms[i].addr);
+}
+
+//----------------------------------------------------------------------
+// Percent
+// 	Return "n" as a percentage of "total", in tenths of a percent.
+//----------------------------------------------------------------------
+
+static int
+Percent(int n, int total)
+{
+    if (total == 0)
+	return 0;
+    return (int) ((1000.0 * n) / total);
+}
+
+//----------------------------------------------------------------------
+// UserProfile::Print
+// 	Print the profile: a flat profile by procedure, the opcodes
+//	executed, the call graph, and the hottest instructions.
+//----------------------------------------------------------------------
+
+void
+UserProfile::Print()
+{
+    ProfileSymbol *syms = NULL;
+    int numSyms = ReadSymbols(fileName, &syms);
+    int opCounts[MaxOpcode + 1];
+    int hottest[NumHottest];
+    int i, j, k, sum;
+    OpenFile *executable;
+    NoffHeader noffH;
+    ProfileArc *proc;
+
+    // Turn the difference array into counts.
+    for (i = 0, sum = 0; i < numWords; i++) {
+	sum += counts[i];
+	counts[i] = sum;
+    }
+    counts[numWords] = 0;
+
+    printf("\nProfile of %s", fileName);
+    if (pid >= 0)
+	printf(" (pid %d)", pid);
+    printf(": %d instructions\n", total);
+    if (numSyms == 0)
+	printf("(no symbols: %s.coff not found)\n", fileName);
+
+    // Flat profile, by instructions run in each procedure itself.
+    if (numSyms > 0) {
+	for (i = 0; i < numWords; i++)
+	    if (counts[i] != 0) {
+		j = FindSymbol(syms, numSyms, i * 4);
+		if (j >= 0)
+		    syms[j].self += counts[i];
+	    }
+	printf("\n    self      %%  inclusive    calls  procedure\n");
+	for (;;) {
+	    for (j = -1, i = 0; i < numSyms; i++)	// largest left
+		if ((syms[i].self > 0)
+			&& ((j < 0) || (syms[i].self > syms[j].self)))
+		    j = i;
+	    if (j < 0)
+		break;
+	    proc = NULL;
+	    for (i = 0; i < procsSize; i++)
+		if ((procs[i].count != -1) && (procs[i].callee == syms[j].addr))
+		    proc = &procs[i];
+	    printf("%8d %3d.%d%% %10d %8d  %s\n", syms[j].self,
+		Percent(syms[j].self, total) / 10,
+		Percent(syms[j].self, total) % 10,
+		(proc != NULL) ? proc->inclusive : 0,
+		(proc != NULL) ? proc->count : 0, syms[j].name);
+	    syms[j].self = -syms[j].self;	// done with this one
+	}
+    }
+
+    // Opcode histogram, decoding the program's code from its file.
+    executable = fileSystem->Open(fileName);
+    if ((executable != NULL)
+	    && (executable->ReadAt((char *) &noffH, sizeof(noffH), 0)
+			== sizeof(noffH))
+	    && (noffH.noffMagic == NOFFMAGIC)) {
+	char *code = new char[noffH.code.size];
+	Instruction instr;
+
+	executable->ReadAt(code, noffH.code.size, noffH.code.inFileAddr);
+	for (i = 0; i <= MaxOpcode; i++)
+	    opCounts[i] = 0;
+	for (i = 0; i + 4 <= noffH.code.size; i += 4) {
+	    j = (noffH.code.virtualAddr + i) / 4;
+	    if ((j >= numWords) || (counts[j] == 0))
+		continue;
+	    instr.value = WordToHost(*(unsigned int *) &code[i]);
+	    instr.Decode();
+	    opCounts[instr.opCode] += counts[j];
+	}
+	delete [] code;
+
+	printf("\n   count      %%  opcode\n");
+	for (;;) {
+	    for (j = -1, i = 0; i <= MaxOpcode; i++)
+		if ((opCounts[i] > 0)
+			&& ((j < 0) || (opCounts[i] > opCounts[j])))
+		    j = i;
+	    if (j < 0)
+		break;
+	    printf("%8d %3d.%d%%  ", opCounts[j],
+		Percent(opCounts[j], total) / 10,
+		Percent(opCounts[j], total) % 10);
+	    for (k = 0; (opStrings[j].string[k] != '\0')
+			&& (opStrings[j].string[k] != ' '); k++)
+		putchar(opStrings[j].string[k]);	// just the mnemonic
+	    putchar('\n');
+	    opCounts[j] = 0;
+	}
+    }
+    if (executable != NULL)
+	delete executable;
+
+    // Call graph.
+    if (numArcs > 0) {
+	printf("\n   calls  caller -> callee\n");
+	for (i = 0; i < arcsSize; i++)
+	    if (arcs[i].count > 0) {
+		printf("%8d  ", arcs[i].count);
+		PrintAddress(syms, numSyms, arcs[i].site);
+		printf(" -> ");
+		PrintAddress(syms, numSyms, arcs[i].callee);
+		putchar('\n');
+	    }
+    }
+
+    // The hottest instructions.
+    for (k = 0; k < NumHottest; k++) {
+	hottest[k] = -1;
+	for (i = 0; i < numWords; i++)
+	    if ((counts[i] > 0) && ((hottest[k] < 0)
+			|| (counts[i] > counts[hottest[k]]))) {
+		for (j = 0; (j < k) && (hottest[j] != i); j++)
+		    ;
+		if (j == k)			// not already listed
+		    hottest[k] = i;
+	    }
+	if (hottest[k] < 0)
+	    break;
+    }
+    printf("\n   count  instruction\n");
+    for (i = 0; (i < k) && (hottest[i] >= 0); i++) {
+	printf("%8d  0x%x  ", counts[hottest[i]], hottest[i] * 4);
+	PrintAddress(syms, numSyms, hottest[i] * 4);
+	putchar('\n');
+    }
+
+    for (i = 0; i < numSyms; i++)
+	delete [] syms[i].name;
+    if (syms != NULL)
+	delete [] syms;
+}
+
+//----------------------------------------------------------------------
+// PrintProfiles
+// 	Print every profile collected since Nachos started, in the
+//	order the address spaces were created.  Called at Halt.
+//----------------------------------------------------------------------
+
+static void
+PrintProfile(int arg)
+{
+    ((UserProfile *) arg)->Print();
+}
+
+void
+PrintProfiles()
+{
+    if (profiles != NULL)
+	profiles->Mapcar(PrintProfile);
+}
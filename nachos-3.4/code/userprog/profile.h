@@ -0,0 +1,107 @@
+// profile.h
+//	Data structures for profiling user programs.
+//
+//	When Nachos is run with "-P", each address space gets a
+//	UserProfile, which records exactly how many times each
+//	instruction of the program ran, and which procedures called
+//	which.  When Nachos halts, every profile is printed: a flat
+//	profile by procedure (named from the symbol table in the
+//	program's ".coff" file, if it can be found next to the NOFF
+//	file), an opcode histogram, the call graph, and the hottest
+//	instructions.
+//
+//	The simulator counts whole basic blocks at a time (see
+//	Machine::RunBlocks), so leaving the profiler on costs only a
+//	few host instructions per block.  Per-instruction counts are
+//	kept as a difference array: running the block [start, end)
+//	adds one at "start" and subtracts one at "end", and the counts
+//	are summed up when the profile is printed.  The opcode histogram
+//	is computed from the counts at the end, too.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "copyright.h"
+#include "utility.h"
+
+class Instruction;
+
+// One arc in the call graph (caller's call site -> callee), or, with
+// "site" unused, one procedure and the instructions run inside it.
+class ProfileArc {
+  public:
+    int site;			// address of the call instruction
+    int callee;			// address of the procedure called
+    int count;			// # of calls
+    int inclusive;		// instructions run by the callee, and
+				// everything it called
+    int active;			// # of activations on the call stack
+};
+
+// A shadow call stack entry, pushed by a call and popped by jr $31.
+class ProfileFrame {
+  public:
+    int callee;			// procedure called
+    int returnAddr;		// where it will return to
+    int start;			// instructions run before the call
+};
+
+class UserProfile {
+  public:
+    UserProfile(const char *programName, int size);
+				// Profile a run of the program in
+				// "programName", whose address space is
+				// "size" bytes
+    ~UserProfile();
+
+    void Count(int pc, int n) {	// "n" instructions ran, from "pc" on
+	unsigned int first = (unsigned) pc / 4;
+
+	if (first + n <= (unsigned) numWords) {
+	    counts[first]++;
+	    counts[first + n]--;
+	}
+	total += n;
+    }
+    void Branch(Instruction *instr, int pc);
+				// The branch or jump "instr" at "pc" ran
+    void DelaySlot(int pcAfter);	// ... and then its delay slot, which
+				// went to "pcAfter"; note any call or
+				// return
+
+    void Print();		// Print the profile
+    const char *FileName() { return fileName; }
+
+    int pid;			// process that owns the address space
+				// (-1 if unknown)
+
+  private:
+    char *fileName;		// the program's NOFF file
+    int numWords;		// # of instructions in the address space
+    int *counts;		// difference array of execution counts
+    int total;			// instructions run, in all
+
+    int branchPC;		// the branch whose delay slot is still
+    int branchOp, branchReg;	// to run (-1 if none): its opcode and
+				// register rs
+
+    ProfileArc *arcs;		// hash table of call graph arcs
+    ProfileArc *procs;		// hash table of procedures called
+    int arcsSize, numArcs, procsSize, numProcs;
+    ProfileArc *Lookup(ProfileArc **table, int *size, int *num,
+			int site, int callee);
+
+    ProfileFrame *stack;	// the shadow call stack
+    int stackSize, depth;
+    void Call(int site, int callee);
+    void Return(int returnAddr);
+};
+
+extern bool profileUserPrograms;	// give each address space a profile?
+extern void PrintProfiles();		// print every profile (at Halt)
+
+#endif // PROFILE_H
@@ -30,10 +30,9 @@ StartProcess(char *filename)
 	printf("Unable to open file %s\n", filename);
 	return;
     }
-    space = new AddrSpace(executable);    
+    space = new AddrSpace(executable);	// (it closes the file)
     currentThread->space = space;
-
-    delete executable;			// close file
+    space->StartProfile(filename);
 
     space->InitRegisters();		// set the initial register values
     space->RestoreState();		// load page table register
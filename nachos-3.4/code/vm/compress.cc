@@ -0,0 +1,260 @@
+// compress.cc
+//	Routines to compress pages into the pool, and get them back.
+//	See compress.h.
+//
+//	The compressed form of a page is a sequence of groups: a control
+//	byte, then eight items, each a literal byte (if its bit in the
+//	control byte is 0) or a copy of 3 to 18 bytes from up to 4095
+//	bytes back in the page (if it is 1), in two bytes: 12 bits of
+//	offset, then 4 bits of length - 3.  Matches are found through a
+//	hash table of the last position each 3-byte string was seen at.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "memorymanager.h"
+#include "swap.h"
+#include "compress.h"
+
+#define HashSize	4096		// entries in the match table
+#define MaxOffset	4095		// how far back a match may be
+#define MinMatch	3		// shortest and longest matches
+#define MaxMatch	18
+
+//----------------------------------------------------------------------
+// Compress
+// 	Compress the "n" bytes at "src" into "dst".  Returns the number
+//	of bytes the compressed form takes, or -1 if it would take more
+//	than "max".
+//----------------------------------------------------------------------
+
+static int
+Compress(unsigned char *src, int n, unsigned char *dst, int max)
+{
+    static int table[HashSize];		// last place each string was seen
+    int in = 0, out = 0, control = 0, bit = 8;
+    int len, offset, candidate;
+    unsigned int hash;
+
+    for (int i = 0; i < HashSize; i++)
+	table[i] = -1;
+    while (in < n) {
+	if (bit == 8) {			// start a new group
+	    if (out >= max)
+		return -1;
+	    control = out++;
+	    dst[control] = 0;
+	    bit = 0;
+	}
+	len = 0;
+	if (in + MinMatch <= n) {
+	    hash = ((src[in] << 16) | (src[in + 1] << 8) | src[in + 2])
+			* 2654435761u >> 20;
+	    candidate = table[hash];
+	    table[hash] = in;
+	    if ((candidate != -1) && (in - candidate <= MaxOffset)
+		    && (src[candidate] == src[in])
+		    && (src[candidate + 1] == src[in + 1])
+		    && (src[candidate + 2] == src[in + 2])) {
+		for (len = MinMatch; (len < MaxMatch) && (in + len < n)
+			&& (src[candidate + len] == src[in + len]); len++)
+		    ;
+		offset = in - candidate;
+	    }
+	}
+	if (len > 0) {
+	    if (out + 2 > max)
+		return -1;
+	    dst[control] |= 1 << bit;
+	    dst[out++] = offset >> 4;
+	    dst[out++] = ((offset & 15) << 4) | (len - MinMatch);
+	    in += len;
+	} else {
+	    if (out + 1 > max)
+		return -1;
+	    dst[out++] = src[in++];
+	}
+	bit++;
+    }
+    return out;
+}
+
+//----------------------------------------------------------------------
+// Decompress
+// 	Expand the compressed form at "src" back into the "n" bytes at
+//	"dst".
+//----------------------------------------------------------------------
+
+static void
+Decompress(unsigned char *src, unsigned char *dst, int n)
+{
+    int in = 0, out = 0, control, offset, len;
+
+    while (out < n) {
+	control = src[in++];
+	for (int bit = 0; (bit < 8) && (out < n); bit++)
+	    if (control & (1 << bit)) {
+		offset = (src[in] << 4) | (src[in + 1] >> 4);
+		len = (src[in + 1] & 15) + MinMatch;
+		in += 2;
+		for (int i = 0; i < len; i++, out++)
+		    dst[out] = dst[out - offset];
+	    } else
+		dst[out++] = src[in++];
+    }
+}
+
+//----------------------------------------------------------------------
+// CompressedPool::CompressedPool
+// 	Set aside "numFrames" contiguous frames (rounded down to a power
+//	of two) for the pool, if there are that many free; otherwise, or
+//	if "numFrames" is 0, there is no pool, and every page goes to
+//	disk.
+//----------------------------------------------------------------------
+
+CompressedPool::CompressedPool(int numFrames)
+{
+    int order, first = -1;
+
+    for (order = 0; (2 << order) <= numFrames; order++)
+	;
+    if (numFrames > 0)
+	first = mm->AllocateRun(order);
+    chunkSize = max(PageSize / 32, 8);
+    numChunks = (first == -1) ? 0 : (PageSize << order) / chunkSize;
+    pool = (first == -1) ? NULL : &machine->mainMemory[first * PageSize];
+    used = new BitMap(max(numChunks, 1));
+    entries = new PoolEntry[max(numChunks, 1)];
+    for (int i = 0; i < numChunks; i++)
+	entries[i].owner = NULL;
+    buffer = new char[PageSize];
+    clock = 0;
+    DEBUG('a', "Compressed pool: %d chunks of %d bytes\n", numChunks,
+		chunkSize);
+}
+
+//----------------------------------------------------------------------
+// CompressedPool::~CompressedPool
+// 	De-allocate the pool.  (The frames it had are never given back;
+//	Nachos is halting.)
+//----------------------------------------------------------------------
+
+CompressedPool::~CompressedPool()
+{
+    delete used;
+    delete [] entries;
+    delete [] buffer;
+}
+
+//----------------------------------------------------------------------
+// CompressedPool::FindChunks
+// 	Return the first of "chunks" free chunks in a row, or -1 if
+//	there aren't that many together.
+//----------------------------------------------------------------------
+
+int
+CompressedPool::FindChunks(int chunks)
+{
+    int start = 0, run = 0;
+
+    for (int i = 0; i < numChunks; i++)
+	if (used->Test(i)) {
+	    start = i + 1;
+	    run = 0;
+	} else if (++run == chunks)
+	    return start;
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// CompressedPool::SpillOldest
+// 	Make room in the pool by moving the page that was put in it
+//	longest ago out to its swap file on disk.
+//----------------------------------------------------------------------
+
+void
+CompressedPool::SpillOldest()
+{
+    int oldest = -1;
+
+    for (int i = 0; i < numChunks; i++)
+	if ((entries[i].owner != NULL) && ((oldest == -1)
+		|| (entries[i].stamp < entries[oldest].stamp)))
+	    oldest = i;
+    ASSERT(oldest != -1);
+    stats->numPoolSpills++;
+    entries[oldest].owner->Spill(entries[oldest].vpn);	// (Frees it)
+}
+
+//----------------------------------------------------------------------
+// CompressedPool::Store
+// 	Compress the page at "from" -- page "vpn" of the address space
+//	whose swap file is "owner" -- into the pool, moving older pages
+//	out to disk if there isn't room.  Returns the entry that holds
+//	it, or -1 if there is no pool, or the page doesn't compress to
+//	three quarters of its size.
+//----------------------------------------------------------------------
+
+int
+CompressedPool::Store(SwapFile *owner, int vpn, char *from)
+{
+    int length, chunks, start;
+
+    if (numChunks == 0)
+	return -1;
+    length = Compress((unsigned char *) from, PageSize,
+			(unsigned char *) buffer, PageSize * 3 / 4);
+    if (length == -1) {
+	stats->numPoolRejects++;
+	return -1;
+    }
+    chunks = divRoundUp(length, chunkSize);
+    while ((start = FindChunks(chunks)) == -1)
+	SpillOldest();
+
+    for (int i = start; i < start + chunks; i++)
+	used->Mark(i);
+    bcopy(buffer, pool + start * chunkSize, length);
+    entries[start].owner = owner;	// (entries are indexed by
+    entries[start].vpn = vpn;		// their first chunk)
+    entries[start].start = start;
+    entries[start].chunks = chunks;
+    entries[start].length = length;
+    entries[start].stamp = ++clock;
+    stats->numPoolStores++;
+    stats->numPoolBytes += length;
+    DEBUG('a', "Compressed page %d to %d bytes\n", vpn, length);
+    return start;
+}
+
+//----------------------------------------------------------------------
+// CompressedPool::Load
+// 	Decompress the page in "entry" into "into".  It stays in the
+//	pool, so that it needn't be stored again unless it changes.
+//----------------------------------------------------------------------
+
+void
+CompressedPool::Load(int entry, char *into)
+{
+    ASSERT(entries[entry].owner != NULL);
+    Decompress((unsigned char *) pool + entries[entry].start * chunkSize,
+		(unsigned char *) into, PageSize);
+}
+
+//----------------------------------------------------------------------
+// CompressedPool::Free
+// 	The page in "entry" has changed, or its address space is gone;
+//	give its chunks back.
+//----------------------------------------------------------------------
+
+void
+CompressedPool::Free(int entry)
+{
+    for (int i = entries[entry].start;
+		i < entries[entry].start + entries[entry].chunks; i++)
+	used->Clear(i);
+    entries[entry].owner = NULL;
+}
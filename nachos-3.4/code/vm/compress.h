@@ -0,0 +1,66 @@
+// compress.h
+//	Data structures for the compressed page pool: a tier between
+//	memory and the swap files on disk.
+//
+//	A few frames are set aside, at startup, for the pool.  A page
+//	being saved to swap is compressed first (with a simple LZ77
+//	scheme, in the style of LZRW1), and if it shrinks to three
+//	quarters of its size or less, it is kept in the pool instead of
+//	being written to disk; reading it back is just decompressing it.
+//	Pages that don't compress that well go straight to disk, and
+//	when the pool is full, the pages that were put in it longest ago
+//	are moved out to their swap files to make room.
+//
+//	The pool is divided into chunks, and each page takes as many
+//	contiguous chunks as its compressed form needs.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include "copyright.h"
+#include "bitmap.h"
+
+class SwapFile;
+
+// A compressed page in the pool.
+class PoolEntry {
+  public:
+    SwapFile *owner;			// whose page it is (NULL if the
+    int vpn;				// entry is unused), and which
+    int start, chunks;			// where it is in the pool
+    int length;				// # of bytes, compressed
+    int stamp;				// when it was put there
+};
+
+class CompressedPool {
+  public:
+    CompressedPool(int numFrames);	// Set aside "numFrames" frames
+					// (0 for no pool)
+    ~CompressedPool();
+
+    int Store(SwapFile *owner, int vpn, char *from);
+					// Compress page "vpn" of "owner"
+					// into the pool; return where, or
+					// -1 if it doesn't compress well
+    void Load(int entry, char *into);	// Decompress it into "into"
+    void Free(int entry);		// It is no longer needed
+
+  private:
+    char *pool;				// the frames we set aside
+    int numChunks, chunkSize;
+    BitMap *used;			// which chunks are in use
+    PoolEntry *entries;			// one per chunk, at most
+    char *buffer;			// a page, compressed
+    int clock;				// counts Stores, for "stamp"
+
+    int FindChunks(int chunks);		// Find room, or -1
+    void SpillOldest();			// Make room
+};
+
+extern CompressedPool *compressedPool;
+
+#endif // COMPRESS_H
@@ -0,0 +1,396 @@
+// frametable.cc
+//	Routines to hand out physical frames to user pages, taking them
+//	away from other pages when memory is full.  See frametable.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "addrspace.h"
+#include "memorymanager.h"
+#include "swap.h"
+#include "image.h"
+#include "frametable.h"
+#include "pageout.h"
+#ifdef USE_TLB
+#include "tlb.h"
+#endif
+
+// A frame the page-out daemon is going to free, and which page it held
+// when the clock chose it (or, if no address space mapped it, which
+// program image's code it was).
+class CleanVictim {
+  public:
+    int frame;
+    AddrSpace *space;
+    int vpn;
+    ProgramImage *text;
+};
+
+//----------------------------------------------------------------------
+// FrameTable::FrameTable
+// 	Initialize the frame table: nothing is mapped yet.
+//----------------------------------------------------------------------
+
+FrameTable::FrameTable()
+{
+    frames = new FrameEntry[NumPhysPages];
+    for (int i = 0; i < NumPhysPages; i++) {
+	frames[i].mappings = NULL;
+	frames[i].locked = FALSE;
+	frames[i].text = NULL;
+	frames[i].textVpn = 0;
+    }
+    hand = 0;
+}
+
+//----------------------------------------------------------------------
+// FrameTable::~FrameTable
+// 	De-allocate the frame table.
+//----------------------------------------------------------------------
+
+FrameTable::~FrameTable()
+{
+    delete [] frames;
+}
+
+//----------------------------------------------------------------------
+// FrameTable::Map
+// 	Record that virtual page "vpn" of "space" maps "frame".  The
+//	caller accounts for the reference in the MemoryManager.
+//----------------------------------------------------------------------
+
+void
+FrameTable::Map(int frame, AddrSpace *space, int vpn)
+{
+    FrameMapping *m = new FrameMapping;
+
+    m->space = space;
+    m->vpn = vpn;
+    m->next = frames[frame].mappings;
+    frames[frame].mappings = m;
+}
+
+//----------------------------------------------------------------------
+// FrameTable::SetText
+// 	Record that "image" keeps "frame" as its code page "vpn", so
+//	that we can tell it when we evict the frame; or, if "image" is
+//	NULL, that it has let go of it.
+//----------------------------------------------------------------------
+
+void
+FrameTable::SetText(int frame, ProgramImage *image, int vpn)
+{
+    frames[frame].text = image;
+    frames[frame].textVpn = vpn;
+}
+
+//----------------------------------------------------------------------
+// FrameTable::Release
+// 	Called when page "vpn" of "space" stops mapping "frame": it is
+//	going away, or it has made a copy of a shared page, or it has been
+//	suspended.  (It may map the frame at other pages too, if it is
+//	the frame of zeroes.)  Once nobody maps the frame, it is free for
+//	anyone.
+//----------------------------------------------------------------------
+
+void
+FrameTable::Release(int frame, AddrSpace *space, int vpn)
+{
+    FrameMapping **p, *m;
+
+    for (p = &frames[frame].mappings; ((*p)->space != space)
+		|| ((*p)->vpn != vpn); p = &(*p)->next)
+	ASSERT((*p)->next != NULL);
+    m = *p;
+    *p = m->next;
+    delete m;
+    if (frames[frame].mappings == NULL)
+	frames[frame].locked = FALSE;
+    mm->DeallocatePage(frame);
+}
+
+//----------------------------------------------------------------------
+// FrameTable::Victim
+// 	Run the clock: return the first frame, from the hand on, that
+//	none of its pages has used since we last looked, and clear the
+//	use bits of the ones that have.  A frame of code that no address
+//	space maps any more is fair game straight away.  The frame of
+//	zeroes is never evicted.  Returns -1 if every frame is locked.
+//
+//	Either way, the soft TLB is flushed: a page still in it would
+//	never have its use bit set again, and would look idle next time.
+//----------------------------------------------------------------------
+
+int
+FrameTable::Victim()
+{
+    TranslationEntry *pte;
+    FrameMapping *m;
+    bool used;
+    int frame, i;
+
+#ifdef USE_TLB
+    tlbManager->Sync();			// the bits are in the TLB
+#endif
+    for (i = 0; i < 2 * NumPhysPages; i++) {	// twice round, at most
+	frame = hand;
+	hand = (hand + 1) % NumPhysPages;
+	if (((frames[frame].mappings == NULL) && (frames[frame].text == NULL))
+		|| frames[frame].locked || mm->IsZeroFrame(frame))
+	    continue;
+	used = FALSE;
+	for (m = frames[frame].mappings; m != NULL; m = m->next) {
+	    pte = &m->space->GetPageTable()[m->vpn];
+	    used = used || pte->use;
+	    pte->use = FALSE;		// second chance
+	}
+	if (!used)
+	    break;
+    }
+    machine->FlushSoftTLB();
+    return (i < 2 * NumPhysPages) ? frame : -1;
+}
+
+//----------------------------------------------------------------------
+// FrameTable::Evict
+// 	Take "frame" away from every page that maps it, which frees it.
+//	Each page that has changed since it was last saved is saved to
+//	its own address space's swap file (making one, if this is the
+//	first time).  A frame of code is never dirty; the image keeping
+//	it just forgets it, and reloads it from the executable next time.
+//----------------------------------------------------------------------
+
+void
+FrameTable::Evict(int frame)
+{
+    FrameMapping *m;
+
+    while ((m = frames[frame].mappings) != NULL) {
+	PageOut(frame, m->space, m->vpn);
+	frames[frame].mappings = m->next;
+	delete m;
+	mm->DeallocatePage(frame);
+    }
+    if (frames[frame].text != NULL)
+	frames[frame].text->ForgetTextFrame(frames[frame].textVpn);
+    machine->FlushSoftTLB();
+}
+
+//----------------------------------------------------------------------
+// FrameTable::PageOut
+// 	Take "frame" away from page "vpn" of "space", saving the page to
+//	swap if it has changed.  The caller takes the page off the frame's
+//	list of mappings.
+//----------------------------------------------------------------------
+
+void
+FrameTable::PageOut(int frame, AddrSpace *space, int vpn)
+{
+    TranslationEntry *pte = &space->GetPageTable()[vpn];
+
+#ifdef USE_TLB
+    tlbManager->Evict(space, vpn);	// (copying back its dirty bit)
+#endif
+    space->ReadAheadLost(vpn);
+    pte->valid = FALSE;
+    if (pte->dirty) {
+	if (space->swap == NULL)
+	    space->swap = new SwapFile(space->GetNumPages());
+	space->swap->Write(vpn, &machine->mainMemory[frame * PageSize]);
+	pte->dirty = FALSE;
+	stats->numPageOuts++;
+    }
+    DEBUG('a', "Evicted virtual page %d from frame %d\n", vpn, frame);
+}
+
+//----------------------------------------------------------------------
+// FrameTable::SwapOut
+// 	Take every page "space" has in memory away from it, when it is
+//	suspended to make room for other processes.  Frames that other
+//	address spaces (or a program image) share stay where they are;
+//	we only drop our mapping of them.  Pages that are locked, being
+//	filled or copied, stay too.
+//----------------------------------------------------------------------
+
+void
+FrameTable::SwapOut(AddrSpace *space)
+{
+    TranslationEntry *pageTable = space->GetPageTable();
+    int frame;
+
+    for (unsigned int vpn = 0; vpn < space->GetNumPages(); vpn++) {
+	if (!pageTable[vpn].valid)
+	    continue;
+	frame = pageTable[vpn].physicalPage;
+	if (frames[frame].locked)
+	    continue;
+	PageOut(frame, space, vpn);
+	Release(frame, space, vpn);
+    }
+    machine->FlushSoftTLB();
+}
+
+//----------------------------------------------------------------------
+// FrameTable::Merge
+// 	Move every page that maps "from" over to "into", which has the
+//	same contents, and free "from".  Pages mapping either frame are
+//	read-only from now on, and get a copy of their own the first
+//	time they are written to.  (Each keeps its dirty bit: whether
+//	or not the contents are the same as in its swap file or the
+//	executable hasn't changed.)
+//----------------------------------------------------------------------
+
+void
+FrameTable::Merge(int from, int into)
+{
+    FrameMapping *m;
+
+    ASSERT(!frames[from].locked && !frames[into].locked);
+    for (m = frames[into].mappings; m != NULL; m = m->next)
+	WriteProtect(m);
+    while ((m = frames[from].mappings) != NULL) {
+	WriteProtect(m);
+	m->space->GetPageTable()[m->vpn].physicalPage = into;
+	frames[from].mappings = m->next;
+	m->next = frames[into].mappings;
+	frames[into].mappings = m;
+	mm->Share(into);
+	mm->DeallocatePage(from);
+    }
+    machine->FlushSoftTLB();
+}
+
+//----------------------------------------------------------------------
+// FrameTable::WriteProtect
+// 	Make the page "m" read-only, copy-on-write, taking it out of the
+//	TLB (which may have it writable).
+//----------------------------------------------------------------------
+
+void
+FrameTable::WriteProtect(FrameMapping *m)
+{
+#ifdef USE_TLB
+    tlbManager->Evict(m->space, m->vpn);	// (copying back its dirty bit)
+#endif
+    m->space->GetPageTable()[m->vpn].readOnly = TRUE;
+    m->space->GetCopyOnWrite()[m->vpn] = TRUE;
+}
+
+//----------------------------------------------------------------------
+// FrameTable::GetFrame
+// 	Return a frame to hold virtual page "vpn" of "space": a free
+//	one if there is one, else one we take from other pages.  The
+//	frame is locked, so it won't be taken away while the caller
+//	fills it; the caller unlocks it when the page is valid.
+//
+//	If "zeroed" is set, the frame is all zeroes.
+//
+//	Writing a page out may block us, and another thread may take the
+//	frame we freed before we get it; if so, we evict another.
+//
+//	Returns -1 if no frame can be had.
+//----------------------------------------------------------------------
+
+int
+FrameTable::GetFrame(AddrSpace *space, int vpn, bool zeroed)
+{
+    int frame = zeroed ? mm->AllocateZeroedPage() : mm->AllocatePage();
+    int start = stats->totalTicks, victim;
+
+    if (frame == -1) {
+	do {
+	    victim = Victim();
+	    if (victim == -1)
+		return -1;
+	    Evict(victim);
+	    frame = zeroed ? mm->AllocateZeroedPage() : mm->AllocatePage();
+	} while (frame == -1);
+	stats->numFaultEvictions++;	// (the page-out daemon fell behind)
+	stats->numFaultWaitTicks += stats->totalTicks - start;
+    }
+    Map(frame, space, vpn);
+    frames[frame].locked = TRUE;
+    pageOutDaemon->Check();		// (may be time to free some more)
+    return frame;
+}
+
+//----------------------------------------------------------------------
+// FrameTable::Clean
+// 	Free up to "count" frames (but no more than PageOutBatch), for
+//	the page-out daemon.  The clock chooses them all first; then we
+//	evict them sorted by where their pages go in swap -- address
+//	space by address space, in order of virtual page -- so that the
+//	dirty ones are written out in one pass over each swap file,
+//	instead of in whatever order the clock found them.
+//
+//	Writing a page out may block the daemon, and let other threads
+//	run and change what the frames hold.  So before evicting each,
+//	we make sure it still holds the page it did, and isn't locked.
+//
+//	Returns how many frames were freed.
+//----------------------------------------------------------------------
+
+int
+FrameTable::Clean(int count)
+{
+    CleanVictim batch[PageOutBatch], v;
+    int n, i, freed = 0;
+
+    count = min(count, PageOutBatch);
+    for (n = 0; n < count; n++) {
+	v.frame = Victim();
+	for (i = 0; (i < n) && (batch[i].frame != v.frame); i++)
+	    ;
+	if ((v.frame == -1) || (i < n))
+	    break;			// nothing left, or round again
+	if (frames[v.frame].mappings != NULL) {
+	    v.space = frames[v.frame].mappings->space;
+	    v.vpn = frames[v.frame].mappings->vpn;
+	    v.text = NULL;
+	} else {
+	    v.space = NULL;
+	    v.vpn = frames[v.frame].textVpn;
+	    v.text = frames[v.frame].text;
+	}
+	for (i = n; (i > 0) && ((v.space < batch[i - 1].space)
+		|| ((v.space == batch[i - 1].space)
+		    && (v.vpn < batch[i - 1].vpn))); i--)
+	    batch[i] = batch[i - 1];
+	batch[i] = v;
+    }
+    for (i = 0; i < n; i++)
+	if (Holds(batch[i].frame, batch[i].space, batch[i].vpn,
+		batch[i].text)) {
+	    Evict(batch[i].frame);
+	    freed++;
+	}
+    DEBUG('a', "Cleaned %d of %d frames\n", freed, n);
+    return freed;
+}
+
+//----------------------------------------------------------------------
+// FrameTable::Holds
+// 	Return TRUE if "frame" is unlocked, and still holds page "vpn" of
+//	"space" -- or, if "space" is NULL, is still code page "vpn" of
+//	"text", with no address space mapping it.
+//----------------------------------------------------------------------
+
+bool
+FrameTable::Holds(int frame, AddrSpace *space, int vpn, ProgramImage *text)
+{
+    FrameMapping *m;
+
+    if (frames[frame].locked)
+	return FALSE;
+    if (space == NULL)
+	return (frames[frame].mappings == NULL)
+		&& (frames[frame].text == text)
+		&& (frames[frame].textVpn == vpn);
+    for (m = frames[frame].mappings; m != NULL; m = m->next)
+	if ((m->space == space) && (m->vpn == vpn))
+	    return TRUE;
+    return FALSE;
+}
@@ -0,0 +1,97 @@
+// frametable.h
+//	Data structures for managing physical memory when there is more
+//	virtual memory than there are frames to hold it.
+//
+//	The frame table records, for every frame, which address spaces
+//	and virtual pages map it (the reverse of the page tables): more
+//	than one, if it is shared copy-on-write or holds program code.
+//	A frame of code is kept by its program's image even when no
+//	address space maps it, until the clock evicts it.
+//	When there is no free frame, the clock algorithm picks a page
+//	to evict: the hand sweeps round the frames, clearing use bits,
+//	and takes the first page that hasn't been used since the hand
+//	last passed it.  Only dirty pages are written to swap; a clean
+//	page can be got back from wherever it came from -- its swap
+//	file, or else the program's executable (or zeroes).
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef FRAMETABLE_H
+#define FRAMETABLE_H
+
+#include "copyright.h"
+
+#define PageOutBatch 8			// frames the page-out daemon frees
+					// at a time
+
+class AddrSpace;
+class ProgramImage;
+
+// One page mapping a frame: page "vpn" of address space "space".
+class FrameMapping {
+  public:
+    AddrSpace *space;
+    int vpn;
+    FrameMapping *next;			// the frame's next mapping
+};
+
+// What a frame holds: the pages that map it, if any.
+class FrameEntry {
+  public:
+    FrameMapping *mappings;		// NULL if the frame is free
+    bool locked;			// being filled or copied; don't
+					// evict it
+    ProgramImage *text;			// if it is code page "textVpn" of a
+    int textVpn;			// program, which image keeps it
+};
+
+class FrameTable {
+  public:
+    FrameTable();			// All frames start out free
+    ~FrameTable();
+
+    int GetFrame(AddrSpace *space, int vpn, bool zeroed);
+					// Find a frame for "space"'s page
+					// "vpn" (all zeroes, if "zeroed"),
+					// evicting some other page if need
+					// be; -1 if there is none
+    void Map(int frame, AddrSpace *space, int vpn);
+					// "space"'s page "vpn" maps "frame"
+					// (as well as any others)
+    void Lock(int frame) { frames[frame].locked = TRUE; }
+    void Unlock(int frame) { frames[frame].locked = FALSE; }
+					// it may be evicted from now on
+    void Release(int frame, AddrSpace *space, int vpn);
+					// "space"'s page "vpn" no longer
+					// maps "frame"
+    void SwapOut(AddrSpace *space);	// Take every page away from "space"
+    int Clean(int count);		// Free up to "count" frames, for
+					// the page-out daemon
+    void Merge(int from, int into);	// Move the pages mapping "from" to
+					// "into", which has the same
+					// contents, copy-on-write
+    bool IsMapped(int frame) { return frames[frame].mappings != NULL; }
+    bool IsLocked(int frame) { return frames[frame].locked; }
+    bool IsText(int frame) { return frames[frame].text != NULL; }
+    void SetText(int frame, ProgramImage *image, int vpn);
+					// "image" keeps "frame" as its code
+					// page "vpn" (or nobody does: NULL)
+
+  private:
+    FrameEntry *frames;			// one per physical page
+    int hand;				// the clock hand
+
+    int Victim();			// Choose a page to evict
+    void Evict(int frame);		// Take its frame away from it
+    void PageOut(int frame, AddrSpace *space, int vpn);
+					// Take it away from one page
+    void WriteProtect(FrameMapping *m);	// Make "m" copy-on-write
+    bool Holds(int frame, AddrSpace *space, int vpn, ProgramImage *text);
+					// Does "frame" still hold that page?
+};
+
+extern FrameTable *frameTable;
+
+#endif // FRAMETABLE_H
@@ -0,0 +1,307 @@
+// loadcontrol.cc
+//	Routines to estimate each process's working set, and suspend
+//	and resume processes so that the working sets of the ones in
+//	memory fit.  See loadcontrol.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "synch.h"
+#include "addrspace.h"
+#include "frametable.h"
+#include "loadcontrol.h"
+#ifdef USE_TLB
+#include "tlb.h"
+#endif
+
+//----------------------------------------------------------------------
+// LoadControl::LoadControl
+// 	Initialize load control: there are no processes yet.
+//----------------------------------------------------------------------
+
+LoadControl::LoadControl()
+{
+    processes = NULL;
+    clock = 0;
+}
+
+//----------------------------------------------------------------------
+// LoadControl::~LoadControl
+// 	De-allocate what we know about any processes still around.
+//----------------------------------------------------------------------
+
+LoadControl::~LoadControl()
+{
+    ProcessLoad *p;
+
+    while ((p = processes) != NULL) {
+	processes = p->next;
+	delete p->resumed;
+	delete p;
+    }
+}
+
+//----------------------------------------------------------------------
+// LoadControl::Find
+// 	Return what we know about "space", or NULL if it isn't ours.
+//----------------------------------------------------------------------
+
+ProcessLoad *
+LoadControl::Find(AddrSpace *space)
+{
+    ProcessLoad *p;
+
+    for (p = processes; p != NULL; p = p->next)
+	if (p->space == space)
+	    break;
+    return p;
+}
+
+//----------------------------------------------------------------------
+// LoadControl::Admit
+// 	Start keeping track of a new address space.  It starts out with
+//	no pages, and so needs none, as far as we know; it only gets
+//	suspended once it is faulting pages in.
+//----------------------------------------------------------------------
+
+void
+LoadControl::Admit(AddrSpace *space)
+{
+    ProcessLoad *p = new ProcessLoad;
+
+    p->space = space;
+    p->suspended = p->waiting = FALSE;
+    p->resumed = new Semaphore("resumed", 0);
+    p->order = ++clock;
+    p->workingSet = 0;
+    p->windowStart = p->runTicks = 0;
+    p->runningSince = -1;
+    p->admitted = stats->totalTicks;
+    p->faults = p->suspensions = 0;
+    p->next = processes;
+    processes = p;
+}
+
+//----------------------------------------------------------------------
+// LoadControl::Leave
+// 	"space" is being deleted.  Report how it did (with "-d a"), and
+//	see whether there is now room for a process we suspended.
+//----------------------------------------------------------------------
+
+void
+LoadControl::Leave(AddrSpace *space)
+{
+    ProcessLoad **q, *p;
+    int ticks;
+
+    for (q = &processes; (*q != NULL) && ((*q)->space != space);
+		q = &(*q)->next)
+	;
+    if (*q == NULL)
+	return;
+    p = *q;
+    Stopped(space);			// (while Find can still see it)
+    *q = p->next;
+    ticks = stats->totalTicks - p->admitted;
+    DEBUG('a', "Load: [%d] %d faults in %d ticks run (%d per 1000), ran %d of "
+	"%d ticks (%d%%), working set %d pages, suspended %d times\n",
+	(space->pcb != NULL) ? space->pcb->pid : -1, p->faults, p->runTicks,
+	(p->runTicks > 0) ? p->faults * 1000 / p->runTicks : 0,
+	p->runTicks, ticks, (ticks > 0) ? p->runTicks * 100 / ticks : 0,
+	p->workingSet, p->suspensions);
+    delete p->resumed;
+    delete p;
+    Balance();
+}
+
+//----------------------------------------------------------------------
+// LoadControl::Running
+// LoadControl::Stopped
+// 	Keep track of each process's own running time, by which its
+//	working set is measured: "space"'s thread is being switched in,
+//	or out.
+//----------------------------------------------------------------------
+
+void
+LoadControl::Running(AddrSpace *space)
+{
+    ProcessLoad *p = Find(space);
+
+    if (p != NULL)
+	p->runningSince = stats->userTicks;
+}
+
+void
+LoadControl::Stopped(AddrSpace *space)
+{
+    ProcessLoad *p = Find(space);
+
+    if ((p != NULL) && (p->runningSince != -1)) {
+	p->runTicks += stats->userTicks - p->runningSince;
+	p->runningSince = -1;
+    }
+}
+
+//----------------------------------------------------------------------
+// LoadControl::Sample
+// 	Count the pages "p" has used since we last looked, and clear
+//	their use bits, so that next time we see only the pages it has
+//	used since now.
+//----------------------------------------------------------------------
+
+void
+LoadControl::Sample(ProcessLoad *p)
+{
+    TranslationEntry *pageTable = p->space->GetPageTable();
+    int used = 0;
+
+#ifdef USE_TLB
+    tlbManager->Sync();			// the bits are in the TLB
+#endif
+    for (unsigned int i = 0; i < p->space->GetNumPages(); i++)
+	if (pageTable[i].valid && pageTable[i].use) {
+	    used++;
+	    pageTable[i].use = FALSE;
+	}
+    machine->FlushSoftTLB();		// (it only holds used pages)
+    p->workingSet = used;
+}
+
+//----------------------------------------------------------------------
+// LoadControl::Fault
+// 	Called when the running process, "space", page faults, before
+//	the page is brought in.  Update its working set: count it
+//	afresh if a window has gone by, else add the page it is missing.
+//	Then suspend or resume processes as need be; if "space" has been
+//	suspended, its thread waits here until it is resumed.
+//----------------------------------------------------------------------
+
+void
+LoadControl::Fault(AddrSpace *space)
+{
+    ProcessLoad *p = Find(space);
+    int now;
+
+    if (p == NULL)
+	return;
+    p->faults++;
+    now = p->runTicks;
+    if (p->runningSince != -1)
+	now += stats->userTicks - p->runningSince;
+    if (now - p->windowStart >= WorkingSetWindow) {
+	Sample(p);
+	p->windowStart = now;
+    }
+    if (p->workingSet < (int) space->GetNumPages())
+	p->workingSet++;
+
+    Balance();
+    if (p->suspended) {
+	DEBUG('a', "Process waits for its pages to be let back in\n");
+	p->waiting = TRUE;
+	p->resumed->P();
+	p->waiting = FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// LoadControl::Balance
+// 	While the working sets of the processes in memory add up to more
+//	than there are frames, suspend the one let in last (unless it is
+//	the only one).  Then resume suspended processes, oldest first,
+//	for as long as their working sets fit.
+//----------------------------------------------------------------------
+
+void
+LoadControl::Balance()
+{
+    ProcessLoad *p, *pick;
+    int demand, active;
+
+    for (;;) {
+	demand = active = 0;
+	pick = NULL;
+	for (p = processes; p != NULL; p = p->next)
+	    if (!p->suspended) {
+		demand += p->workingSet;
+		active++;
+		if ((pick == NULL) || (p->order > pick->order))
+		    pick = p;
+	    }
+	if ((demand <= NumPhysPages) || (active <= 1))
+	    break;
+	Suspend(pick);
+    }
+
+    for (;;) {
+	pick = NULL;
+	for (p = processes; p != NULL; p = p->next)
+	    if (p->suspended && ((pick == NULL) || (p->order < pick->order)))
+		pick = p;
+	if ((pick == NULL) || ((active > 0)
+		&& (demand + pick->workingSet > NumPhysPages)))
+	    break;
+	Resume(pick);
+	demand += pick->workingSet;
+	active++;
+    }
+}
+
+//----------------------------------------------------------------------
+// LoadControl::Suspend
+// 	Take all of "p"'s pages away, so that the other processes have
+//	room to run.  Its thread finds out at its next page fault.
+//----------------------------------------------------------------------
+
+void
+LoadControl::Suspend(ProcessLoad *p)
+{
+    DEBUG('a', "Suspending a process, working set %d pages\n",
+		p->workingSet);
+    p->suspended = TRUE;
+    p->suspensions++;
+    stats->numSuspensions++;
+    frameTable->SwapOut(p->space);
+}
+
+//----------------------------------------------------------------------
+// LoadControl::Resume
+// 	Let "p" back in: it is the newest process in memory now, and its
+//	thread can go on with its page fault.
+//----------------------------------------------------------------------
+
+void
+LoadControl::Resume(ProcessLoad *p)
+{
+    DEBUG('a', "Resuming a process, working set %d pages\n",
+		p->workingSet);
+    p->suspended = FALSE;
+    p->order = ++clock;
+    if (p->waiting)
+	p->resumed->V();
+}
+
+//----------------------------------------------------------------------
+// LoadControl::ResumeIdle
+// 	Called when there is no thread ready to run.  If that is because
+//	the processes that could run are suspended, and waiting to be
+//	resumed, resume the oldest of them, working set or no.  Returns
+//	TRUE if we did.
+//----------------------------------------------------------------------
+
+bool
+LoadControl::ResumeIdle()
+{
+    ProcessLoad *p, *pick = NULL;
+
+    for (p = processes; p != NULL; p = p->next)
+	if (p->waiting && ((pick == NULL) || (p->order < pick->order)))
+	    pick = p;
+    if (pick == NULL)
+	return FALSE;
+    Resume(pick);
+    return TRUE;
+}
@@ -0,0 +1,80 @@
+// loadcontrol.h
+//	Data structures for load control: keeping the number of
+//	processes competing for memory down to what fits, so that the
+//	system doesn't thrash.
+//
+//	Each process's working set -- the pages it needs in memory to
+//	run without faulting all the time -- is estimated from its use
+//	bits: every WorkingSetWindow ticks of its own running time, at
+//	its next page fault, we count the pages it has used since the
+//	last count, and clear their use bits.  In between, every fault
+//	adds a page to the estimate (if a process is faulting, it needs
+//	more than it has).
+//
+//	If the working sets of the processes in memory add up to more
+//	than there are frames, the one most recently let in is suspended:
+//	all its pages are taken away, and when it next runs it waits, at
+//	its first page fault, until it is resumed.  Suspended processes
+//	are resumed, oldest first, once their working sets fit again --
+//	or when they are all that could run.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef LOADCONTROL_H
+#define LOADCONTROL_H
+
+#include "copyright.h"
+
+#define WorkingSetWindow 1000		// user ticks between samples
+
+class AddrSpace;
+class Semaphore;
+
+// What we know about one address space.
+class ProcessLoad {
+  public:
+    AddrSpace *space;
+    bool suspended;			// its pages have been taken away
+    bool waiting;			// its thread is waiting to resume,
+    Semaphore *resumed;			// on this
+    int order;				// when it was let in (again)
+    int workingSet;			// # of pages it needs, we reckon
+    int windowStart;			// its time when we last counted
+    int runTicks;			// user ticks it has run, not
+    int runningSince;			// counting since it last started
+    int admitted;			// when it was created
+    int faults, suspensions;		// for the statistics
+    ProcessLoad *next;
+};
+
+class LoadControl {
+  public:
+    LoadControl();			// No processes yet
+    ~LoadControl();
+
+    void Admit(AddrSpace *space);	// A new address space
+    void Leave(AddrSpace *space);	// ... is going away; report on it
+    void Running(AddrSpace *space);	// Its thread is switched in
+    void Stopped(AddrSpace *space);	// ... or out
+    void Fault(AddrSpace *space);	// The running process page faults;
+					// it may have to wait
+    bool ResumeIdle();			// Nothing else can run; resume a
+					// suspended process, if there is one
+
+  private:
+    ProcessLoad *processes;		// every address space we know of
+    int clock;				// counts admissions, for "order"
+
+    ProcessLoad *Find(AddrSpace *space);
+    void Sample(ProcessLoad *p);	// Count its working set
+    void Balance();			// Suspend or resume processes, so
+					// that the working sets fit
+    void Suspend(ProcessLoad *p);
+    void Resume(ProcessLoad *p);
+};
+
+extern LoadControl *loadControl;
+
+#endif // LOADCONTROL_H
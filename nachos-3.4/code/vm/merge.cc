@@ -0,0 +1,123 @@
+// merge.cc
+//	Routines to find frames with the same contents, and merge them
+//	into one.  See merge.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "memorymanager.h"
+#include "frametable.h"
+#include "merge.h"
+
+//----------------------------------------------------------------------
+// PageMerger::PageMerger
+// 	Initialize the merger: we haven't looked at any frames yet.
+//
+//	"scanRate" is how many frames to look at each time Scan is called
+//----------------------------------------------------------------------
+
+PageMerger::PageMerger(int scanRate)
+{
+    rate = scanRate;
+    hand = 0;
+    checksums = new unsigned int[NumPhysPages];
+    tableSize = NumPhysPages;
+    table = new int[tableSize];
+    for (int i = 0; i < NumPhysPages; i++) {
+	checksums[i] = 0;
+	table[i] = -1;
+    }
+}
+
+//----------------------------------------------------------------------
+// PageMerger::~PageMerger
+// 	De-allocate the merger's tables.
+//----------------------------------------------------------------------
+
+PageMerger::~PageMerger()
+{
+    delete [] checksums;
+    delete [] table;
+}
+
+//----------------------------------------------------------------------
+// PageMerger::Checksum
+// 	Return a checksum of the contents of "frame" (FNV-1a, a word at
+//	a time).
+//----------------------------------------------------------------------
+
+unsigned int
+PageMerger::Checksum(int frame)
+{
+    unsigned int *word = (unsigned int *) &machine->mainMemory[frame * PageSize];
+    unsigned int sum = 2166136261u;
+
+    for (int i = 0; i < PageSize / (int) sizeof(unsigned int); i++)
+	sum = (sum ^ word[i]) * 16777619u;
+    return sum;
+}
+
+//----------------------------------------------------------------------
+// PageMerger::CanMerge
+// 	Return TRUE if the pages mapping "frame" may be moved to another
+//	frame, or other pages moved to it: it is in use by user pages,
+//	nobody is filling or copying it, and it isn't program code.
+//----------------------------------------------------------------------
+
+bool
+PageMerger::CanMerge(int frame)
+{
+    return (mm->RefCount(frame) > 0) && frameTable->IsMapped(frame)
+		&& !frameTable->IsLocked(frame) && !frameTable->IsText(frame);
+}
+
+//----------------------------------------------------------------------
+// PageMerger::Scan
+// 	Look at the next "rate" frames.  A frame whose checksum has
+//	changed since we last looked is still being written to, so we
+//	just note the new checksum.  Otherwise, if the hash table holds
+//	a frame with the same checksum, and really the same contents,
+//	merge the two; if not, this frame goes in the table.
+//----------------------------------------------------------------------
+
+void
+PageMerger::Scan()
+{
+    int frame, other, slot;
+    unsigned int sum;
+
+    for (int i = 0; i < rate; i++) {
+	frame = hand;
+	hand = (hand + 1) % NumPhysPages;
+	stats->numMergeScans++;
+	if (!CanMerge(frame) && !mm->IsZeroFrame(frame))
+	    continue;
+	sum = Checksum(frame);
+	if ((sum != checksums[frame]) && !mm->IsZeroFrame(frame)) {
+	    checksums[frame] = sum;	// changing; wait for it to settle
+	    continue;
+	}
+	checksums[frame] = sum;
+
+	slot = sum % tableSize;
+	other = table[slot];
+	table[slot] = frame;
+	if ((other == -1) || (other == frame) || (checksums[other] != sum)
+		|| !(CanMerge(other) || mm->IsZeroFrame(other))
+		|| bcmp(&machine->mainMemory[frame * PageSize],
+			&machine->mainMemory[other * PageSize], PageSize))
+	    continue;
+
+	if (mm->IsZeroFrame(frame)) {	// the frame of zeroes stays
+	    frameTable->Merge(other, frame);
+	} else {
+	    frameTable->Merge(frame, other);
+	    table[slot] = other;
+	}
+	stats->numMergedFrames++;
+	DEBUG('a', "Merged frames %d and %d\n", frame, other);
+    }
+}
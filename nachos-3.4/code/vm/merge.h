@@ -0,0 +1,53 @@
+// merge.h
+//	Data structures for merging frames with the same contents, so
+//	that many processes running the same program -- with the same
+//	initialized data, and the same arrays of zeroes -- fit into
+//	less memory.
+//
+//	At each context switch, the merger looks at the next few frames
+//	in memory, round and round: it checksums each one, and once a
+//	frame's checksum has stayed the same from one look to the next,
+//	looks it up in a hash table of such frames.  If that turns up a
+//	frame with the same contents, the pages mapping the one frame
+//	are moved over to the other, and the first is freed.  Every page
+//	mapping the merged frame is read-only and copy-on-write from
+//	then on, so the first write to any of them gets it a copy of its
+//	own again (see AddrSpace::CopyOnWrite).  A frame of zeroes is
+//	merged into the frame of zeroes everybody shares.
+//
+//	Frames of program code are left alone: they are shared already.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef MERGE_H
+#define MERGE_H
+
+#include "copyright.h"
+
+#define DefaultMergeRate 8		// frames to look at per switch
+
+class PageMerger {
+  public:
+    PageMerger(int scanRate);		// Look at "scanRate" frames per Scan;
+					// 0 means never
+    ~PageMerger();
+
+    void Scan();			// Look at the next few frames
+
+  private:
+    int rate;				// frames to look at per Scan
+    int hand;				// the next one
+    unsigned int *checksums;		// of each frame, when we last
+					// looked at it
+    int *table;				// a frame with each checksum
+    int tableSize;			// (modulo this), or -1
+
+    unsigned int Checksum(int frame);
+    bool CanMerge(int frame);		// Is "frame" one we may touch?
+};
+
+extern PageMerger *pageMerger;
+
+#endif // MERGE_H
@@ -0,0 +1,100 @@
+// pageout.cc
+//	Routines for the page-out daemon, which keeps some frames free
+//	for page faults.  See pageout.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "synch.h"
+#include "memorymanager.h"
+#include "frametable.h"
+#include "pageout.h"
+
+//----------------------------------------------------------------------
+// PageOutThread
+// 	The body of the daemon's thread.  "arg" is not used.
+//----------------------------------------------------------------------
+
+static void
+PageOutThread(int arg)
+{
+    pageOutDaemon->Run();
+}
+
+//----------------------------------------------------------------------
+// PageOutDaemon::PageOutDaemon
+// 	Start the daemon's thread, which waits until it is needed.
+//
+//	"freeTarget" is how many frames to keep free (none, if 0: the
+//	daemon doesn't run, and page faults evict pages themselves)
+//----------------------------------------------------------------------
+
+PageOutDaemon::PageOutDaemon(int freeTarget)
+{
+    target = freeTarget;
+    awake = FALSE;
+    wakeup = new Semaphore("page-out wakeup", 0);
+    if (target > 0) {
+	Thread *t = new Thread("page-out daemon");
+
+	t->Fork(PageOutThread, 0);
+    }
+}
+
+//----------------------------------------------------------------------
+// PageOutDaemon::~PageOutDaemon
+// 	De-allocate the daemon's semaphore.
+//----------------------------------------------------------------------
+
+PageOutDaemon::~PageOutDaemon()
+{
+    delete wakeup;
+}
+
+//----------------------------------------------------------------------
+// PageOutDaemon::Check
+// 	Called whenever a frame is handed out to a page.  If that leaves
+//	fewer than "target" free, wake the daemon to free some more.  It
+//	runs the next time the scheduler gets to it; the caller goes on.
+//----------------------------------------------------------------------
+
+void
+PageOutDaemon::Check()
+{
+    if ((target == 0) || awake || ((int) mm->GetFreePageCount() >= target))
+	return;
+    awake = TRUE;
+    wakeup->V();
+}
+
+//----------------------------------------------------------------------
+// PageOutDaemon::Run
+// 	Each time we are woken, free frames a batch at a time until
+//	"target" of them are free, or there is nothing left we may evict.
+//	Never returns.
+//----------------------------------------------------------------------
+
+void
+PageOutDaemon::Run()
+{
+    int free, freed, written;
+
+    for (;;) {
+	wakeup->P();
+	stats->numPageOutWakeups++;
+	written = stats->numPageOuts;
+	while ((free = mm->GetFreePageCount()) < target) {
+	    freed = frameTable->Clean(target - free);
+	    if (freed == 0)
+		break;			// everything is locked
+	    stats->numPageOutFrees += freed;
+	}
+	stats->numPageOutWrites += stats->numPageOuts - written;
+	DEBUG('a', "Page-out daemon: %d frames free\n",
+		mm->GetFreePageCount());
+	awake = FALSE;
+    }
+}
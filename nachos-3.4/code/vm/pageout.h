@@ -0,0 +1,46 @@
+// pageout.h
+//	Data structures for the page-out daemon: a kernel thread that
+//	frees frames ahead of time, so that a page fault seldom has to
+//	evict a page -- and wait for it to be written to swap -- before
+//	it can have a frame.
+//
+//	Whenever a frame is handed out and fewer than "target" frames are
+//	left free, the daemon is woken.  It takes frames away from pages
+//	the clock picks, PageOutBatch at a time, until "target" frames are
+//	free again; within a batch, dirty pages are written out in the
+//	order they go in their swap files (see FrameTable::Clean).  Then
+//	it goes back to sleep.  If a fault finds no free frame anyway, it
+//	evicts a page itself, as before.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef PAGEOUT_H
+#define PAGEOUT_H
+
+#include "copyright.h"
+
+class Semaphore;
+
+class PageOutDaemon {
+  public:
+    PageOutDaemon(int freeTarget);	// Keep "freeTarget" frames free; 0
+					// means never run at all
+    ~PageOutDaemon();
+
+    void Check();			// Wake the daemon, if too few
+					// frames are free
+    void Run();			// The daemon itself
+    bool IsIdle() { return (target > 0) && !awake; }
+					// Is its thread waiting to be woken?
+
+  private:
+    int target;				// free frames to keep
+    bool awake;				// already working on it?
+    Semaphore *wakeup;			// V'ed to wake the daemon
+};
+
+extern PageOutDaemon *pageOutDaemon;
+
+#endif // PAGEOUT_H
@@ -0,0 +1,157 @@
+// swap.cc
+//	Routines to save an address space's pages to its swap area,
+//	and to read them back.  See swap.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "compress.h"
+#include "swap.h"
+#include "sysdep.h"
+#ifdef HOST_SPARC
+#include <strings.h>
+#endif
+
+static int numSwapFiles = 0;		// for naming them
+
+//----------------------------------------------------------------------
+// SwapFile::SwapFile
+// 	Set up a swap area with room for "size" pages, none of which are
+//	in it yet.  The file on disk is only made when it is needed.
+//----------------------------------------------------------------------
+
+SwapFile::SwapFile(int size)
+{
+    numPages = size;
+    sprintf(name, "SWAP.%d", numSwapFiles++);
+    fd = -1;
+    saved = new BitMap(numPages);
+    pooled = new int[numPages];
+    for (int i = 0; i < numPages; i++)
+	pooled[i] = -1;
+}
+
+//----------------------------------------------------------------------
+// SwapFile::~SwapFile
+// 	Give back our pages in the pool, and close and remove the swap
+//	file, if there is one; the address space is gone.
+//----------------------------------------------------------------------
+
+SwapFile::~SwapFile()
+{
+    for (int i = 0; i < numPages; i++)
+	if (pooled[i] != -1)
+	    compressedPool->Free(pooled[i]);
+    if (fd != -1) {
+	Close(fd);
+	Unlink(name);
+    }
+    delete saved;
+    delete [] pooled;
+}
+
+//----------------------------------------------------------------------
+// SwapFile::WriteDisk
+// 	Save the contents of virtual page "vpn", at "from", to the swap
+//	file, making the file if this is the first page to go there.
+//----------------------------------------------------------------------
+
+void
+SwapFile::WriteDisk(int vpn, char *from)
+{
+    if (fd == -1) {
+	fd = OpenForWrite(name);
+	DEBUG('a', "Created swap file %s, %d pages\n", name, numPages);
+    }
+    Lseek(fd, vpn * PageSize, 0);
+    WriteFile(fd, from, PageSize);
+    saved->Mark(vpn);
+    stats->numSwapDiskIOs++;
+}
+
+//----------------------------------------------------------------------
+// SwapFile::Write
+// 	Save the contents of virtual page "vpn", at "from" in main
+//	memory: compressed in the pool if it will go, else to the swap
+//	file.  Any copy we had before is out of date.
+//----------------------------------------------------------------------
+
+void
+SwapFile::Write(int vpn, char *from)
+{
+    if (pooled[vpn] != -1) {
+	compressedPool->Free(pooled[vpn]);
+	pooled[vpn] = -1;
+    }
+    saved->Clear(vpn);
+    pooled[vpn] = compressedPool->Store(this, vpn, from);
+    if (pooled[vpn] == -1)
+	WriteDisk(vpn, from);
+}
+
+//----------------------------------------------------------------------
+// SwapFile::Read
+// 	Read virtual page "vpn" back, into "into": from the pool if it
+//	is there, else from the swap file.  The copy stays where it is,
+//	so that the page needn't be written again when it is next
+//	evicted, unless it has changed.
+//----------------------------------------------------------------------
+
+void
+SwapFile::Read(int vpn, char *into)
+{
+    if (pooled[vpn] != -1) {
+	compressedPool->Load(pooled[vpn], into);
+	stats->numPoolHits++;
+	return;
+    }
+    ASSERT(saved->Test(vpn));
+    Lseek(fd, vpn * PageSize, 0);
+    ::Read(fd, into, PageSize);
+    stats->numSwapDiskIOs++;
+}
+
+//----------------------------------------------------------------------
+// SwapFile::ReadRun
+// 	Read the "count" pages from "vpn" on back from the swap file,
+//	where they are next to each other, with a single read, and put
+//	page vpn + i at "into[i]".  One read costs a single seek, where
+//	reading the pages one at a time would seek for each.
+//----------------------------------------------------------------------
+
+void
+SwapFile::ReadRun(int vpn, int count, char **into)
+{
+    char *buffer = new char[count * PageSize];
+    int i;
+
+    for (i = 0; i < count; i++)
+	ASSERT(OnDisk(vpn + i));
+    Lseek(fd, vpn * PageSize, 0);
+    ::Read(fd, buffer, count * PageSize);
+    for (i = 0; i < count; i++)
+	bcopy(buffer + i * PageSize, into[i], PageSize);
+    delete [] buffer;
+    stats->numSwapDiskIOs += count;
+}
+
+//----------------------------------------------------------------------
+// SwapFile::Spill
+// 	The pool needs room: move page "vpn" out of it, to the swap file.
+//----------------------------------------------------------------------
+
+void
+SwapFile::Spill(int vpn)
+{
+    char *page = new char[PageSize];
+
+    ASSERT(pooled[vpn] != -1);
+    compressedPool->Load(pooled[vpn], page);
+    compressedPool->Free(pooled[vpn]);
+    pooled[vpn] = -1;
+    WriteDisk(vpn, page);
+    delete [] page;
+}
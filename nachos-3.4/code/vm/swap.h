@@ -0,0 +1,52 @@
+// swap.h
+//	Data structures for an address space's swap area: where its
+//	pages go when their frames are taken away from it, if they have
+//	been changed since they were loaded.
+//
+//	A page goes into the compressed pool if it can (see compress.h),
+//	and otherwise into a file of the address space's own, "SWAP.<n>",
+//	with room for every one of its pages; page i lives at offset
+//	i * PageSize.  The file is only made when the first page has to
+//	go there.  It is a file on the host, whichever file system Nachos
+//	has: a Nachos file can't be big enough for a large address space
+//	(and the Nachos directory only has room for a few files).
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef SWAP_H
+#define SWAP_H
+
+#include "copyright.h"
+#include "bitmap.h"
+
+class SwapFile {
+  public:
+    SwapFile(int size);			// Make a swap area for "size" pages
+    ~SwapFile();			// Remove it
+
+    bool Has(int vpn) { return (pooled[vpn] != -1) || saved->Test(vpn); }
+					// Have we a copy of page "vpn"?
+    bool OnDisk(int vpn) { return (pooled[vpn] == -1) && saved->Test(vpn); }
+					// ... in the file, that is?
+    void Write(int vpn, char *from);	// Save page "vpn" from "from"
+    void Read(int vpn, char *into);	// Read it back into "into"
+    void ReadRun(int vpn, int count, char **into);
+					// Read "count" pages from "vpn" on
+					// back from the file, at once
+    void Spill(int vpn);		// Move it from the pool to disk
+
+  private:
+    int numPages;
+    char name[16];			// "SWAP.<n>"
+    int fd;				// the file, on the host; -1 until
+					// we need it
+    BitMap *saved;			// pages we have a copy of on disk
+    int *pooled;			// where each page is in the pool,
+					// or -1
+
+    void WriteDisk(int vpn, char *from);
+};
+
+#endif // SWAP_H
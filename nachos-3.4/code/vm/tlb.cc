@@ -0,0 +1,328 @@
+// tlb.cc
+//	Routines to manage the software-loaded TLB: refilling it on a
+//	miss, choosing which entry to replace, and handing out the
+//	address space identifiers its entries are tagged with.  See tlb.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "addrspace.h"
+#include "tlb.h"
+
+//----------------------------------------------------------------------
+// ParseTLBPolicy
+// 	Turn the name of a replacement policy, from the command line,
+//	into a TLBPolicy.  Returns FALSE if there is no such policy.
+//----------------------------------------------------------------------
+
+bool
+ParseTLBPolicy(const char *name, TLBPolicy *policy)
+{
+    if (!strcmp(name, "random"))
+	*policy = TLBRandom;
+    else if (!strcmp(name, "fifo"))
+	*policy = TLBFifo;
+    else if (!strcmp(name, "clock"))
+	*policy = TLBClock;
+    else
+	return FALSE;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// TLBManager::TLBManager
+// 	Initialize the TLB manager.  The machine's TLB starts out empty.
+//
+//	"replacementPolicy" -- how to choose an entry to replace
+//----------------------------------------------------------------------
+
+TLBManager::TLBManager(TLBPolicy replacementPolicy)
+{
+    policy = replacementPolicy;
+    hand = new int[TLBSets];
+    for (int i = 0; i < TLBSets; i++)
+	hand[i] = 0;
+    running = NULL;
+    for (int i = 0; i < NumASIDs; i++)
+	owner[i] = NULL;
+    nextASID = 0;
+    generation = 0;
+}
+
+//----------------------------------------------------------------------
+// TLBManager::~TLBManager
+// 	De-allocate the TLB manager.
+//----------------------------------------------------------------------
+
+TLBManager::~TLBManager()
+{
+    delete [] hand;
+}
+
+//----------------------------------------------------------------------
+// TLBManager::WriteBack
+// 	Copy the use and dirty bits the machine set in a TLB entry back
+//	to the page table of the address space it belongs to, where the
+//	rest of the kernel looks for them.
+//----------------------------------------------------------------------
+
+void
+TLBManager::WriteBack(TranslationEntry *entry)
+{
+    TranslationEntry *pte = &owner[entry->asid]->GetPageTable()
+						[entry->virtualPage];
+
+    pte->use |= entry->use;
+    pte->dirty |= entry->dirty;
+}
+
+//----------------------------------------------------------------------
+// TLBManager::Victim
+// 	Choose the entry of a TLB set to replace: a free one if there is
+//	one, else whichever the replacement policy picks.
+//
+//	"set" -- the TLBWays entries of the set
+//	"setNum" -- which set it is
+//----------------------------------------------------------------------
+
+int
+TLBManager::Victim(TranslationEntry *set, int setNum)
+{
+    int i;
+
+    for (i = 0; i < TLBWays; i++)
+	if (!set[i].valid)
+	    return i;
+
+    switch (policy) {
+      case TLBRandom:
+	return Random() % TLBWays;
+
+      case TLBFifo:
+	i = hand[setNum];
+	hand[setNum] = (i + 1) % TLBWays;
+	return i;
+
+      case TLBClock:
+	for (;;) {			// at most twice round the set
+	    i = hand[setNum];
+	    hand[setNum] = (i + 1) % TLBWays;
+	    if (!set[i].use)
+		return i;
+	    WriteBack(&set[i]);		// (so the page table keeps it)
+	    set[i].use = FALSE;		// second chance
+	}
+    }
+    ASSERT(FALSE);
+    return 0;
+}
+
+//----------------------------------------------------------------------
+// TLBManager::Refill
+// 	Handle a TLB miss: load the current address space's translation
+//	for "virtAddr" into the TLB.  The faulting instruction is then
+//	simply re-executed.
+//
+//	Returns FALSE if the page table has no valid translation either,
+//	in which case this is a real fault, not just a TLB miss.
+//----------------------------------------------------------------------
+
+bool
+TLBManager::Refill(int virtAddr)
+{
+    AddrSpace *space = currentThread->space;
+    unsigned int vpn = (unsigned) virtAddr >> PageShift;
+    TranslationEntry *set, *entry;
+
+    ASSERT((space == running) && (space->asidGeneration == generation));
+    if ((vpn >= space->GetNumPages()) || !space->GetPageTable()[vpn].valid)
+	return FALSE;
+
+    set = machine->TLBSet(vpn);
+    entry = &set[Victim(set, vpn & (TLBSets - 1))];
+    if (entry->valid)
+	WriteBack(entry);
+    *entry = space->GetPageTable()[vpn];
+    entry->asid = space->asid;
+    DEBUG('a', "TLB refill: virtual page %d -> frame %d\n", vpn,
+		entry->physicalPage);
+
+    space->tlbMisses++;
+    space->ReadAheadUsed(vpn);
+    stats->numTLBMisses++;
+    machine->FlushSoftTLB();		// it may have the entry we replaced
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// TLBManager::Flush
+// 	Invalidate every TLB entry, first writing back its use and dirty
+//	bits if "writeBack" is set.
+//----------------------------------------------------------------------
+
+void
+TLBManager::Flush(bool writeBack)
+{
+    for (int i = 0; i < TLBSize; i++)
+	if (machine->tlb[i].valid) {
+	    if (writeBack)
+		WriteBack(&machine->tlb[i]);
+	    machine->tlb[i].valid = FALSE;
+	}
+    machine->FlushSoftTLB();
+}
+
+//----------------------------------------------------------------------
+// TLBManager::Sync
+// 	Copy the use and dirty bits of every TLB entry back to the page
+//	tables, and clear them in the TLB, so that the page tables show
+//	every reference up to now, and the TLB only the ones after.
+//	Called before the kernel looks at (and clears) use bits.
+//----------------------------------------------------------------------
+
+void
+TLBManager::Sync()
+{
+    for (int i = 0; i < TLBSize; i++)
+	if (machine->tlb[i].valid) {
+	    WriteBack(&machine->tlb[i]);
+	    machine->tlb[i].use = machine->tlb[i].dirty = FALSE;
+	}
+    machine->FlushSoftTLB();		// (it only holds pages with the
+					// bits set)
+}
+
+//----------------------------------------------------------------------
+// TLBManager::Evict
+// 	Page "vpn" of "space" is about to lose its frame.  If its
+//	translation is in the TLB, write back its bits, so the kernel
+//	can tell whether it is dirty, and throw it away.
+//----------------------------------------------------------------------
+
+void
+TLBManager::Evict(AddrSpace *space, int vpn)
+{
+    TranslationEntry *set = machine->TLBSet(vpn);
+
+    if (space->asidGeneration != generation)
+	return;				// it has nothing in the TLB
+    for (int i = 0; i < TLBWays; i++)
+	if (set[i].valid && (set[i].asid == space->asid)
+			&& (set[i].virtualPage == (unsigned) vpn)) {
+	    WriteBack(&set[i]);
+	    set[i].valid = FALSE;
+	}
+    machine->FlushSoftTLB();
+}
+
+//----------------------------------------------------------------------
+// TLBManager::CountEntries
+// 	Return how many TLB entries are tagged with "asid".
+//----------------------------------------------------------------------
+
+int
+TLBManager::CountEntries(int asid)
+{
+    int n = 0;
+
+    for (int i = 0; i < TLBSize; i++)
+	if (machine->tlb[i].valid && (machine->tlb[i].asid == asid))
+	    n++;
+    return n;
+}
+
+//----------------------------------------------------------------------
+// TLBManager::NewASID
+// 	Give "space" the next address space identifier.  If there are
+//	none left in this generation, start a new one: every address
+//	space's identifier becomes stale, so none of the TLB entries
+//	can be used again.
+//----------------------------------------------------------------------
+
+void
+TLBManager::NewASID(AddrSpace *space)
+{
+    if (nextASID == NumASIDs) {
+	DEBUG('a', "Out of ASIDs; starting generation %d\n", generation + 1);
+	Flush(TRUE);
+	for (int i = 0; i < NumASIDs; i++)
+	    owner[i] = NULL;
+	nextASID = 0;
+	generation++;
+    }
+    space->asid = nextASID++;
+    space->asidGeneration = generation;
+    owner[space->asid] = space;
+}
+
+//----------------------------------------------------------------------
+// TLBManager::Account
+// 	Charge the TLB hits the machine has counted since we last looked
+//	to the address space that was running, and to the system as a
+//	whole.
+//----------------------------------------------------------------------
+
+void
+TLBManager::Account()
+{
+    if (running != NULL)
+	running->tlbHits += machine->tlbHits;
+    stats->numTLBHits += machine->tlbHits;
+    machine->tlbHits = 0;
+}
+
+//----------------------------------------------------------------------
+// TLBManager::Switch
+// 	Called when "space" is about to run.  Nothing needs flushing:
+//	just point the machine at the identifier of "space", first
+//	giving it one if it has none in this generation.
+//
+//	Also note how many of its TLB entries survived while it wasn't
+//	running.
+//----------------------------------------------------------------------
+
+void
+TLBManager::Switch(AddrSpace *space)
+{
+    if (space == running)
+	return;
+    Account();
+    if (running != NULL)
+	running->tlbEntriesOut = CountEntries(running->asid);
+
+    stats->numTLBSwitchedOut += space->tlbEntriesOut;
+    if (space->asidGeneration == generation)
+	stats->numTLBSurvived += CountEntries(space->asid);
+    else
+	NewASID(space);
+    space->tlbEntriesOut = 0;
+    running = space;
+    machine->asid = space->asid;
+}
+
+//----------------------------------------------------------------------
+// TLBManager::Forget
+// 	Called when "space" is deleted.  Throw away just its own TLB
+//	entries, if it has any; there is no page table to write back
+//	to.  Its identifier isn't handed out again until the next
+//	generation.
+//----------------------------------------------------------------------
+
+void
+TLBManager::Forget(AddrSpace *space)
+{
+    if (space == running) {
+	Account();
+	running = NULL;
+    }
+    if (space->asidGeneration != generation)
+	return;				// its entries were flushed already
+    for (int i = 0; i < TLBSize; i++)
+	if (machine->tlb[i].valid && (machine->tlb[i].asid == space->asid))
+	    machine->tlb[i].valid = FALSE;
+    owner[space->asid] = NULL;
+    machine->FlushSoftTLB();
+}
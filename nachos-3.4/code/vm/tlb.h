@@ -0,0 +1,91 @@
+// tlb.h
+//	Data structures for managing the software-loaded TLB.
+//
+//	With USE_TLB, the machine translates user addresses only through
+//	its TLB.  When the page isn't there, the machine raises a
+//	PageFaultException; the kernel finds the translation in the
+//	address space's page table, loads it into the TLB (replacing
+//	some other entry of the page's set, if need be), and lets the
+//	instruction try again.
+//
+//	The machine sets the use and dirty bits in the TLB entry, not in
+//	the page table, so the bits are copied back to the page table
+//	whenever an entry is replaced or flushed.
+//
+//	Each TLB entry is tagged with an address space identifier (ASID),
+//	and the machine only matches entries tagged with the running
+//	address space's.  So a context switch just changes the machine's
+//	"asid" register: the entries of the address space switched out
+//	stay put, and are still there if it runs again soon enough.
+//
+//	There are only NumASIDs identifiers.  They are handed out in
+//	order, and each one belongs to its address space only for the
+//	current "generation".  When they run out, we start a new
+//	generation: flush the whole TLB, and let every address space
+//	get a new identifier the next time it runs.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef TLBMANAGER_H
+#define TLBMANAGER_H
+
+#include "copyright.h"
+#include "machine.h"
+
+class AddrSpace;
+
+#define NumASIDs	64		// as on the MIPS R2000/R3000
+
+// How to choose which entry of a set to replace, when none is free.
+enum TLBPolicy { TLBRandom,		// any of them
+		 TLBFifo,		// the one loaded longest ago
+		 TLBClock		// one not used since the clock hand
+					// last passed it (approximates LRU)
+};
+
+class TLBManager {
+  public:
+    TLBManager(TLBPolicy replacementPolicy);
+					// Start with an empty TLB
+    ~TLBManager();
+
+    bool Refill(int virtAddr);		// Load the translation of
+					// "virtAddr" for the current address
+					// space; FALSE if it has none
+    void Switch(AddrSpace *space);	// "space" is about to run
+    void Forget(AddrSpace *space);	// "space" is being deleted
+    void Account();			// Charge the TLB hits so far to the
+					// address space that had them
+    void Sync();			// Copy every entry's use and dirty
+					// bits to the page tables
+    void Evict(AddrSpace *space, int vpn);
+					// "space"'s page "vpn" is losing
+					// its frame
+
+  private:
+    TLBPolicy policy;
+    int *hand;				// per set: next entry to replace
+					// (FIFO) or to look at (clock)
+    AddrSpace *running;			// whose TLB hits are being counted
+    AddrSpace *owner[NumASIDs];		// who has each ASID, this generation
+    int nextASID;			// the next one to hand out
+    int generation;
+
+    void NewASID(AddrSpace *space);	// Give "space" an ASID
+    int CountEntries(int asid);		// # of TLB entries tagged "asid"
+    int Victim(TranslationEntry *set, int setNum);
+					// Choose an entry of "set" to replace
+    void WriteBack(TranslationEntry *entry);
+					// Copy an entry's use and dirty bits
+					// to its owner's page table
+    void Flush(bool writeBack);		// Empty the TLB
+};
+
+extern TLBManager *tlbManager;
+
+extern bool ParseTLBPolicy(const char *name, TLBPolicy *policy);
+					// "random", "fifo" or "clock"
+
+#endif // TLBMANAGER_H